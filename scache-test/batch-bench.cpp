@@ -0,0 +1,88 @@
+// 多key指令性能测试：在执行线程中分别以逐个get和一条mget读取同样的key，
+// 批量大小为1、10、100，统计每秒读取的key数量。key随机分布在远大于缓存
+// 的哈希表中，mget预取所有key所在的分组和节点之后再查找。只测试执行线程
+// 中的处理，不包括网络和请求队列。
+// 用法：batch-bench [key数量]，默认2000000个
+#include "bench-util.h"
+#include "cache-config.h"
+#include "cache-server.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+const int64 LOOKUPS = 4000000;
+const int64 BATCH_SIZES[] = { 1, 10, 100 };
+
+// 返回结果的总长度，避免结果被优化掉
+static int64 runGet(const std::vector<std::string>& keys,
+    const std::vector<int>& trace, int64 batch) {
+    static const std::string GET = "get";
+    Request rq;
+    int64 bytes = 0;
+    for (int64 i = 0; i + batch <= (int64)trace.size(); i += batch) {
+        for (int64 j = 0; j < batch; j++) {
+            rq.cmd.clear();
+            rq.cmd.push_back(GET);
+            rq.cmd.push_back(keys[trace[i + j]]);
+            bytes += handleRequest(rq).size();
+        }
+    }
+    return bytes;
+}
+
+static int64 runMultiGet(const std::vector<std::string>& keys,
+    const std::vector<int>& trace, int64 batch) {
+    static const std::string MGET = "mget";
+    Request rq;
+    int64 bytes = 0;
+    for (int64 i = 0; i + batch <= (int64)trace.size(); i += batch) {
+        rq.cmd.clear();
+        rq.cmd.push_back(MGET);
+        for (int64 j = 0; j < batch; j++) {
+            rq.cmd.push_back(keys[trace[i + j]]);
+        }
+        bytes += handleRequest(rq).size();
+    }
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    int64 count = argc > 1 ? std::atoll(argv[1]) : 2000000;
+    char* args[] = { argv[0] };
+    initGlobalConfig(1, args);
+    // 只使用一个分片，所有key都在当前线程的SimpleCache中
+    getGlobalConfig()->shardCount = 1;
+
+    std::vector<std::string> keys(count);
+    auto cache = getSimpleCache();
+    CacheValue value;
+    value.setValue("value:0123456789");
+    for (int64 i = 0; i < count; i++) {
+        keys[i] = "key:" + std::to_string(i);
+        cache->set(keys[i], value);
+    }
+    std::mt19937_64 random(2333);
+    std::vector<int> trace(LOOKUPS);
+    for (auto& x : trace) x = (int)(random() % count);
+
+    std::printf("%-6s %8s %14s %14s %8s\n", "batch", "keys", "get keys/s",
+        "mget keys/s", "speedup");
+    for (int64 batch : BATCH_SIZES) {
+        auto start = Clock::now();
+        int64 getBytes = runGet(keys, trace, batch);
+        double getTime = elapsed(start);
+
+        start = Clock::now();
+        int64 multiBytes = runMultiGet(keys, trace, batch);
+        double multiTime = elapsed(start);
+
+        int64 lookups = LOOKUPS / batch * batch;
+        std::printf("%-6lld %8lld %14.0f %14.0f %7.2fx\n", batch, count,
+            lookups / getTime, lookups / multiTime, getTime / multiTime);
+        if (getBytes == 0 || multiBytes == 0) return 1;
+    }
+    delSimpleCache();
+    return 0;
+}
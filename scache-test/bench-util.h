@@ -0,0 +1,24 @@
+#pragma once
+
+#include "cache-config.h"
+#include <chrono>
+
+// 性能测试共用的计时函数
+using Clock = std::chrono::steady_clock;
+
+// 从start到现在经过的时间(s)
+inline double elapsed(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 从start到现在count次操作平均每次的耗时(ns)
+inline double elapsedNs(Clock::time_point start, int64 count) {
+    return std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / count;
+}
+
+// 当前时间(ns)，用于计算跨线程的延迟
+inline int64 nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,113 @@
+// 连接数量测试：逐步建立空闲连接，每个连接发送一条ping并读取结果之后
+// 保持空闲，统计scache进程RSS的增量，输出每个空闲连接占用的内存。
+// 用法：conn-bench <scache进程号> [端口] [连接数量...]，默认端口2333，
+// 默认测试1000、10000、50000个连接。只支持Linux：RSS读取自/proc，连接
+// 超过25000个时使用多个127.0.0.x作为源地址，避免本地端口耗尽。服务端和
+// 本进程的打开文件数量上限(ulimit -n)需要大于连接数量。
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int SOURCE_PORTS = 25000;
+const char PING[] = "ping\n";
+
+// 进程的RSS(KB)，读取失败时返回-1
+static long long readRss(int pid) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return std::atoll(line.c_str() + 6);
+        }
+    }
+    return -1;
+}
+
+// 建立第index个连接并完成一次ping，失败时返回-1
+static int openSession(int port, int index) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    if (index >= SOURCE_PORTS) {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+        int on = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof(on));
+#endif
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK + index / SOURCE_PORTS);
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        send(fd, PING, sizeof(PING) - 1, 0) != sizeof(PING) - 1) {
+        close(fd);
+        return -1;
+    }
+    // 结果为"7\nok PONG"
+    char reply[64];
+    size_t size = 0;
+    while (size < 9) {
+        auto n = recv(fd, reply + size, sizeof(reply) - size, 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        size += (size_t)n;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::printf("usage: conn-bench <pid> [port] [connections...]\n");
+        return 1;
+    }
+    int pid = std::atoi(argv[1]);
+    int port = argc > 2 ? std::atoi(argv[2]) : 2333;
+    std::vector<int> targets;
+    for (int i = 3; i < argc; i++) targets.push_back(std::atoi(argv[i]));
+    if (targets.empty()) targets = { 1000, 10000, 50000 };
+
+    long long base = readRss(pid);
+    if (base < 0) {
+        std::printf("cannot read RSS of process %d\n", pid);
+        return 1;
+    }
+    std::printf("%-12s %12s %14s\n", "connections", "RSS(KB)",
+        "bytes/conn");
+    std::vector<int> sessions;
+    for (int target : targets) {
+        while ((int)sessions.size() < target) {
+            int fd = openSession(port, (int)sessions.size());
+            if (fd < 0) break;
+            sessions.push_back(fd);
+        }
+        if ((int)sessions.size() < target) {
+            std::printf("stopped at %zu connections: %s\n", sessions.size(),
+                std::strerror(errno));
+            break;
+        }
+        // 等待服务端处理完所有结果
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        long long rss = readRss(pid);
+        std::printf("%-12d %12lld %14.0f\n", target, rss,
+            (rss - base) * 1024.0 / target);
+    }
+    for (int fd : sessions) close(fd);
+    return 0;
+}
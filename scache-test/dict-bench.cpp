@@ -0,0 +1,97 @@
+// CacheDict性能测试：对比开放寻址实现和旧的链式实现的插入与查找耗时
+// 用法：dict-bench [key数量...]，默认测试1M/10M/50M个key
+#include "bench-util.h"
+#include "cache-dict.h"
+#include "chained-dict.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// 旧实现未命中时抛出异常，命中测试使用get，未命中测试使用has
+static int64 lookup(CacheDict<std::string, int64>* dict,
+    const std::string& key) {
+    return dict->find(key)->m_two;
+}
+
+static int64 lookup(ChainedDict<std::string, int64>* dict,
+    const std::string& key) {
+    return dict->get(key).m_two;
+}
+
+struct BenchResult {
+    double insert;
+    double hit;
+    double miss;
+};
+
+template<class D>
+BenchResult runBench(std::vector<std::string>& keys,
+    std::vector<std::string>& order, std::vector<std::string>& misses) {
+    BenchResult result;
+    auto dict = new D();
+    int64 sum = 0;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        CachePair<std::string, int64> pair{ keys[i], (int64)i };
+        dict->set(pair);
+    }
+    result.insert = elapsed(start);
+
+    start = Clock::now();
+    for (auto& key : order) {
+        sum += lookup(dict, key);
+    }
+    result.hit = elapsed(start);
+
+    start = Clock::now();
+    for (auto& key : misses) {
+        sum += dict->has(key);
+    }
+    result.miss = elapsed(start);
+
+    if (sum == -1) std::printf("unreachable\n");
+    delete dict;
+    return result;
+}
+
+static void printResult(const char* name, BenchResult& r, size_t n) {
+    double mops = n / 1000000.0;
+    std::printf("  %-10s insert %7.2f Mops/s  hit %7.2f Mops/s  "
+        "miss %7.2f Mops/s\n", name, mops / r.insert, mops / r.hit,
+        mops / r.miss);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back((size_t)std::atoll(argv[i]));
+    }
+    if (sizes.empty()) sizes = { 1000000, 10000000, 50000000 };
+
+    std::mt19937_64 rng(2333);
+    for (auto n : sizes) {
+        std::vector<std::string> keys, order, misses;
+        keys.reserve(n); misses.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            keys.push_back("key:" + std::to_string(rng()));
+            misses.push_back("miss:" + std::to_string(rng()));
+        }
+        order = keys;
+        std::shuffle(order.begin(), order.end(), rng);
+
+        std::printf("%zu keys\n", n);
+        auto flat = runBench<CacheDict<std::string, int64>>(
+            keys, order, misses);
+        printResult("CacheDict", flat, n);
+        auto chained = runBench<ChainedDict<std::string, int64>>(
+            keys, order, misses);
+        printResult("Chained", chained, n);
+        std::printf("  speedup    insert %.2fx  hit %.2fx  miss %.2fx\n",
+            chained.insert / flat.insert, chained.hit / flat.hit,
+            chained.miss / flat.miss);
+    }
+}
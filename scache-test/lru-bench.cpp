@@ -0,0 +1,130 @@
+// SimpleCache LRU性能测试：Zipf分布的读多写少负载，统计命中率和吞吐量
+// 用法：lru-bench [scache启动参数]，例如 lru-bench -m 100000 -r approx
+// 不带参数时分别以exact和approx模式(-m 100000)各运行一次
+#include "bench-util.h"
+#include "cache-config.h"
+#include "cache-server.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+const int64 KEY_SPACE = 1000000;
+const int64 OPERATIONS = 20000000;
+const double ZIPF_ALPHA = 0.99;
+// 读操作比例，未命中的读操作随后写入该key
+const double READ_RATIO = 0.9;
+
+// 按照Zipf分布生成访问序列，排名到key的映射随机打乱
+static std::vector<int> makeTrace(std::mt19937_64& random) {
+    std::vector<double> cdf(KEY_SPACE);
+    double sum = 0;
+    for (int64 i = 0; i < KEY_SPACE; i++) {
+        sum += 1.0 / std::pow((double)(i + 1), ZIPF_ALPHA);
+        cdf[i] = sum;
+    }
+    std::vector<int> rank(KEY_SPACE);
+    for (int64 i = 0; i < KEY_SPACE; i++) rank[i] = (int)i;
+    std::shuffle(rank.begin(), rank.end(), random);
+
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<int> trace(OPERATIONS);
+    for (auto& x : trace) {
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), uniform(random));
+        x = rank[std::min<int64>(it - cdf.begin(), KEY_SPACE - 1)];
+    }
+    return trace;
+}
+
+// 和服务器的写操作相同：只有创建新的key之前才淘汰数据
+static void write(SimpleCache* cache, const std::string& key,
+    const CacheValue& value) {
+    auto entry = cache->find(key);
+    if (entry) {
+        cache->touch(entry);
+    }
+    else {
+        if (!cache->evict()) return;
+        bool isNew = false;
+        entry = cache->emplace(key, isNew);
+    }
+    cache->set(entry, value);
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        std::string self = argv[0];
+        std::system((self + " -m 100000 -r exact").c_str());
+        std::system((self + " -m 100000 -r approx").c_str());
+        return 0;
+    }
+    initGlobalConfig(argc, argv);
+    auto config = getGlobalConfig();
+    // 只使用一个分片，容量不按照CPU核数划分
+    config->shardCount = 1;
+
+    std::mt19937_64 random(2333);
+    auto trace = makeTrace(random);
+    std::vector<std::string> keys(KEY_SPACE);
+    for (int64 i = 0; i < KEY_SPACE; i++) {
+        keys[i] = "key:" + std::to_string(i);
+    }
+    std::vector<bool> isRead(OPERATIONS);
+    std::bernoulli_distribution read(READ_RATIO);
+    for (int64 i = 0; i < OPERATIONS; i++) isRead[i] = read(random);
+
+    auto cache = getSimpleCache();
+    CacheValue value;
+    value.setValue("value");
+
+    // 第一遍预热，第二遍统计混合负载的命中率和吞吐量
+    int64 hits = 0, reads = 0;
+    double mixed = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        hits = reads = 0;
+        auto start = Clock::now();
+        for (int64 i = 0; i < OPERATIONS; i++) {
+            const std::string& key = keys[trace[i]];
+            if (!isRead[i]) {
+                write(cache, key, value);
+                continue;
+            }
+            reads++;
+            auto entry = cache->find(key);
+            if (entry) {
+                cache->touch(entry);
+                hits++;
+            }
+            else {
+                write(cache, key, value);
+            }
+        }
+        mixed = elapsed(start);
+    }
+
+    // 只读负载：只访问缓存中已经存在的key
+    std::vector<int> present;
+    for (int64 i = 0; i < OPERATIONS && (int64)present.size() < OPERATIONS / 2;
+        i++) {
+        if (cache->find(keys[trace[i]])) present.push_back(trace[i]);
+    }
+    int64 sum = 0;
+    auto start = Clock::now();
+    for (auto x : present) {
+        auto entry = cache->find(keys[x]);
+        cache->touch(entry);
+        sum += entry->getValue().getType();
+    }
+    double readOnly = elapsed(start);
+
+    std::printf("%-6s size %8lld  hit ratio %.4f  mixed %6.2f Mops/s  "
+        "read %6.2f Mops/s\n",
+        config->lruMode.c_str(), cache->getSize(), (double)hits / reads,
+        OPERATIONS / mixed / 1e6, present.size() / readOnly / 1e6);
+    // 避免只读循环被优化掉
+    if (sum < 0) std::printf("%lld\n", sum);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "request-buffer.h"
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+// 旧版本的RequestBuffer(互斥锁和条件变量保护的std::queue)，仅用于
+// queue-bench对比
+
+class MutexRequestBuffer {
+private:
+    std::queue<Request> m_buffer;
+    std::mutex m_lock;
+    std::condition_variable m_addCond;
+    std::condition_variable m_getCond;
+    int64 m_maxSize;
+
+public:
+    MutexRequestBuffer(int64 maxSize) : m_maxSize(maxSize) {}
+
+    void addRequest(Request &rq) {
+        std::unique_lock<std::mutex> lock(m_lock);
+        if ((int64)m_buffer.size() >= m_maxSize) {
+            m_addCond.wait(lock, [this]()
+            { return (int64)m_buffer.size() < m_maxSize / 2; });
+        }
+        m_buffer.push(std::move(rq));
+        m_getCond.notify_one();
+    }
+
+    Request getRequest() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_getCond.wait(lock, [this]() { return !m_buffer.empty(); });
+        auto request = m_buffer.front();
+        m_buffer.pop();
+        m_addCond.notify_one();
+        return request;
+    }
+};
@@ -0,0 +1,133 @@
+// 请求解析性能测试：对比流式RequestParser、RESP2的RespParser和旧的
+// std::regex分词。用法：parser-bench [指令数量]，默认200000条。输入为
+// set/get/dset/ladd混合的指令，其中一部分value使用双引号包围，RESP2输入
+// 为相同token编码的bulk string数组。两个流式解析器按照固定大小的数据块
+// 输入，模拟多次读取，指令可能被数据块截断。
+#include "bench-util.h"
+#include "request-parser.h"
+#include "request-resp.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t CHUNK_SIZE = 4096;
+
+static std::vector<std::string> makeCommands(int64 count) {
+    std::mt19937_64 random(2333);
+    std::vector<std::string> commands;
+    for (int64 i = 0; i < count; i++) {
+        std::string key = "key:" + std::to_string(random() % 1000000);
+        std::string value(16 + random() % 48, 'v');
+        switch (random() % 4) {
+        case 0:
+            commands.push_back("set " + key + " " + value);
+            break;
+        case 1:
+            commands.push_back("get " + key);
+            break;
+        case 2:
+            commands.push_back("dset " + key + " field \"" + value +
+                " with spaces\"");
+            break;
+        default:
+            commands.push_back("ladd " + key + " 1 2 3 " + value);
+            break;
+        }
+    }
+    return commands;
+}
+
+// 旧实现：每次读取的数据作为一条完整的指令，每个token拷贝为std::string
+static int64 regexParse(const std::vector<std::string>& commands) {
+    static std::regex re("(\\S+)|(\"[^\"]*\")");
+    int64 tokens = 0;
+    for (auto& command : commands) {
+        std::vector<std::string> cmd;
+        std::sregex_iterator it(command.begin(), command.end(), re);
+        std::sregex_iterator endIt;
+        for (; it != endIt; ++it) {
+            cmd.push_back(it->str());
+        }
+        tokens += cmd.size();
+    }
+    return tokens;
+}
+
+// 数据按照CHUNK_SIZE分块到达，不完整的指令留在缓冲区中等待下一块
+template<class Parser>
+static int64 streamParse(const std::string& stream, int64& frames) {
+    Parser parser;
+    std::string buffer(CHUNK_SIZE * 2, '\0');
+    size_t size = 0;
+    int64 tokens = 0;
+    std::vector<std::string_view> cmd;
+    for (size_t offset = 0; offset < stream.size(); offset += CHUNK_SIZE) {
+        size_t start = parser.getFrameStart();
+        size_t pending = size - start;
+        buffer.replace(0, pending, buffer, start, pending);
+        parser.moveFrame(0);
+        size_t chunk = std::min(CHUNK_SIZE, stream.size() - offset);
+        if (buffer.size() < pending + chunk) buffer.resize(pending + chunk);
+        buffer.replace(pending, chunk, stream, offset, chunk);
+        size = pending + chunk;
+        while (parser.next(buffer.data(), size, cmd)) {
+            tokens += cmd.size();
+            frames++;
+        }
+    }
+    return tokens;
+}
+
+int main(int argc, char** argv) {
+    int64 count = argc > 1 ? std::atoll(argv[1]) : 200000;
+    auto commands = makeCommands(count);
+    std::string stream;
+    for (auto& command : commands) {
+        stream += command;
+        stream += "\r\n";
+    }
+
+    // 使用文本解析器得到的token生成RESP2输入
+    std::string respStream;
+    {
+        RequestParser parser;
+        std::vector<std::string_view> cmd;
+        while (parser.next(stream.data(), stream.size(), cmd)) {
+            appendRespArray(respStream, cmd.size());
+            for (auto token : cmd) {
+                appendRespBulk(respStream, token);
+            }
+        }
+    }
+
+    auto start = Clock::now();
+    int64 regexTokens = regexParse(commands);
+    double regexTime = elapsed(start);
+
+    start = Clock::now();
+    int64 frames = 0;
+    int64 streamTokens = streamParse<RequestParser>(stream, frames);
+    double streamTime = elapsed(start);
+
+    start = Clock::now();
+    int64 respFrames = 0;
+    int64 respTokens = streamParse<RespParser>(respStream, respFrames);
+    double respTime = elapsed(start);
+
+    double megabytes = stream.size() / 1e6;
+    std::printf("%-8s %10s %10s %12s %10s\n", "parser", "commands",
+        "tokens", "ns/command", "MB/s");
+    std::printf("%-8s %10lld %10lld %12.1f %10.1f\n", "regex", count,
+        regexTokens, regexTime * 1e9 / count, megabytes / regexTime);
+    std::printf("%-8s %10lld %10lld %12.1f %10.1f\n", "stream", frames,
+        streamTokens, streamTime * 1e9 / frames, megabytes / streamTime);
+    std::printf("%-8s %10lld %10lld %12.1f %10.1f\n", "resp", respFrames,
+        respTokens, respTime * 1e9 / respFrames,
+        respStream.size() / 1e6 / respTime);
+    return 0;
+}
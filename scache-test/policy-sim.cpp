@@ -0,0 +1,107 @@
+// 淘汰策略模拟：使用SimpleCache回放访问序列，统计命中率
+// 用法：policy-sim zipf|scan [scache启动参数]，例如
+//     policy-sim scan -m 20000 -e tinylfu
+// 不带参数时对两种访问序列分别运行LRU、近似LRU、随机淘汰和W-TinyLFU。
+// zipf：Zipf分布的访问序列；scan：在zipf的基础上周期性插入批量任务，
+// 依次访问大量只出现一次的key。命中率只统计zipf部分的读操作。
+#include "cache-config.h"
+#include "cache-server.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+const int64 KEY_SPACE = 1000000;
+const int64 OPERATIONS = 5000000;
+const double ZIPF_ALPHA = 0.9;
+// scan：每隔SCAN_PERIOD次访问插入SCAN_LENGTH个一次性key
+const int64 SCAN_PERIOD = 100000;
+const int64 SCAN_LENGTH = 50000;
+
+// 访问序列：非负数为zipf部分的key编号，负数为批量任务的一次性key
+static std::vector<int> makeTrace(bool scan) {
+    std::mt19937_64 random(2333);
+    std::vector<double> cdf(KEY_SPACE);
+    double sum = 0;
+    for (int64 i = 0; i < KEY_SPACE; i++) {
+        sum += 1.0 / std::pow((double)(i + 1), ZIPF_ALPHA);
+        cdf[i] = sum;
+    }
+    std::vector<int> rank(KEY_SPACE);
+    for (int64 i = 0; i < KEY_SPACE; i++) rank[i] = (int)i;
+    std::shuffle(rank.begin(), rank.end(), random);
+
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<int> trace;
+    int scanKey = 0;
+    for (int64 i = 0; i < OPERATIONS; i++) {
+        if (scan && i > 0 && i % SCAN_PERIOD == 0) {
+            for (int64 j = 0; j < SCAN_LENGTH; j++) {
+                trace.push_back(-(++scanKey));
+            }
+        }
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), uniform(random));
+        trace.push_back(rank[std::min<int64>(it - cdf.begin(), KEY_SPACE - 1)]);
+    }
+    return trace;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        const char* policies[] = {
+            "-e allkeys-lru -r exact", "-e allkeys-lru -r approx",
+            "-e allkeys-random", "-e tinylfu" };
+        std::string self = argv[0];
+        for (auto trace : { "zipf", "scan" }) {
+            for (auto policy : policies) {
+                std::system((self + " " + trace + " -m 20000 " + policy)
+                    .c_str());
+            }
+        }
+        return 0;
+    }
+    std::string traceName = argv[1];
+    if (traceName != "zipf" && traceName != "scan") {
+        std::printf("Unknown trace: %s\n", argv[1]);
+        return 1;
+    }
+    // 剩余参数交给scache的参数解析
+    argv[1] = argv[0];
+    initGlobalConfig(argc - 1, argv + 1);
+    auto config = getGlobalConfig();
+    // 只使用一个分片，容量不按照CPU核数划分
+    config->shardCount = 1;
+
+    auto trace = makeTrace(traceName == "scan");
+    auto cache = getSimpleCache();
+    CacheValue value;
+    value.setValue("value");
+
+    int64 hits = 0, reads = 0;
+    for (size_t i = 0; i < trace.size(); i++) {
+        std::string key = trace[i] >= 0 ? "key:" + std::to_string(trace[i]) :
+            "scan:" + std::to_string(-trace[i]);
+        auto entry = cache->find(key);
+        if (trace[i] >= 0) reads++;
+        if (entry) {
+            cache->touch(entry);
+            if (trace[i] >= 0) hits++;
+            continue;
+        }
+        // 未命中时写入缓存
+        if (!cache->evict()) continue;
+        bool isNew = false;
+        entry = cache->emplace(key, isNew);
+        cache->set(entry, value);
+    }
+
+    std::string policy = config->evictionPolicy;
+    if (policy == "allkeys-lru") policy += "(" + config->lruMode + ")";
+    std::printf("%-5s %-20s size %6lld  hit ratio %.4f\n",
+        traceName.c_str(), policy.c_str(), config->maxCacheSize,
+        (double)hits / reads);
+    return 0;
+}
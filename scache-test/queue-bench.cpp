@@ -0,0 +1,131 @@
+// RequestBuffer性能测试：对比无锁环形队列和旧的互斥锁队列
+// 用法：queue-bench [生产者数量...]，默认测试1/2/4/8个生产者。
+// 吞吐量：生产者不间断地添加请求，一个消费者取出请求；延迟：生产者
+// 按照固定速率添加请求，统计入队到出队的时间。请求的m_session存放入队时间。
+#include "bench-util.h"
+#include "request-buffer.h"
+#include "mutex-buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int64 THROUGHPUT_REQUESTS = 2000000;
+// 延迟测试的总速率和请求数量
+const int64 LATENCY_RATE = 100000; // 个/s
+const int64 LATENCY_REQUESTS = 200000;
+const int64 BATCH_SIZE = 64;
+
+struct RingQueue {
+    RequestBuffer* m_buffer = getRequestBuffer();
+    void push(Request& rq) { m_buffer->addRequest(rq); }
+    int64 pop(std::vector<Request>& requests) {
+        return m_buffer->getRequests(requests, BATCH_SIZE);
+    }
+};
+
+struct MutexQueue {
+    MutexRequestBuffer m_buffer{ getGlobalConfig()->requestBufferSize };
+    void push(Request& rq) { m_buffer.addRequest(rq); }
+    int64 pop(std::vector<Request>& requests) {
+        requests.resize(1);
+        requests[0] = m_buffer.getRequest();
+        return 1;
+    }
+};
+
+struct BenchResult {
+    double throughput; // 百万个/s
+    double p50; // us
+    double p99; // us
+};
+
+// interval为每个生产者两次添加之间的间隔(ns)，0表示不间断
+template<class Q>
+static std::vector<int64> runOnce(Q& queue, int64 producers, int64 total,
+    int64 interval, double& seconds) {
+    std::vector<std::thread> threads;
+    int64 each = total / producers;
+    auto start = Clock::now();
+    for (int64 p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, each, interval, p]() {
+            int64 next = nowNanos();
+            for (int64 i = 0; i < each; i++) {
+                if (interval > 0) {
+                    while (nowNanos() < next) std::this_thread::yield();
+                    next += interval;
+                }
+                Request rq;
+                rq.m_data = std::make_shared<std::string>("set key:" +
+                    std::to_string(p * each + i) + " value");
+                std::string_view data = *rq.m_data;
+                rq.cmd = { data.substr(0, 3), data.substr(4, data.size() - 10),
+                    data.substr(data.size() - 5) };
+                rq.m_session = (SessionHandle)nowNanos();
+                queue.push(rq);
+            }
+        });
+    }
+
+    std::vector<int64> latencies;
+    latencies.reserve(each * producers);
+    std::vector<Request> requests;
+    while ((int64)latencies.size() < each * producers) {
+        int64 count = queue.pop(requests);
+        int64 now = nowNanos();
+        for (int64 i = 0; i < count; i++) {
+            latencies.push_back(now - (int64)requests[i].m_session);
+        }
+    }
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return latencies;
+}
+
+template<class Q>
+static BenchResult runBench(int64 producers) {
+    Q queue;
+    BenchResult result;
+    double seconds = 0;
+    runOnce(queue, producers, THROUGHPUT_REQUESTS, 0, seconds);
+    result.throughput = THROUGHPUT_REQUESTS / seconds / 1e6;
+
+    auto latencies = runOnce(queue, producers, LATENCY_REQUESTS,
+        1000000000LL * producers / LATENCY_RATE, seconds);
+    std::sort(latencies.begin(), latencies.end());
+    result.p50 = latencies[latencies.size() / 2] / 1e3;
+    result.p99 = latencies[latencies.size() * 99 / 100] / 1e3;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    // RequestBuffer的容量来自全局配置，使用默认值
+    char* args[] = { argv[0] };
+    initGlobalConfig(1, args);
+    getGlobalConfig()->shardCount = 1;
+
+    std::vector<int64> producers;
+    for (int i = 1; i < argc; i++) {
+        producers.push_back(std::atoll(argv[i]));
+    }
+    if (producers.empty()) {
+        producers = { 1, 2, 4, 8 };
+    }
+
+    std::printf("%-9s %-6s %14s %10s %10s\n", "producers", "queue",
+        "throughput(M/s)", "p50(us)", "p99(us)");
+    for (auto count : producers) {
+        auto ring = runBench<RingQueue>(count);
+        auto mutex = runBench<MutexQueue>(count);
+        std::printf("%-9lld %-6s %14.2f %10.1f %10.1f\n", count, "ring",
+            ring.throughput, ring.p50, ring.p99);
+        std::printf("%-9lld %-6s %14.2f %10.1f %10.1f\n", count, "mutex",
+            mutex.throughput, mutex.p50, mutex.p99);
+    }
+    return 0;
+}
@@ -4,6 +4,7 @@ from scache_client import *
 import optparse
 import time
 import datetime
+import multiprocessing
 
 
 async def warmup(ip, port, number, dict, length=8):
@@ -16,38 +17,149 @@ async def warmup(ip, port, number, dict, length=8):
     await client.close()
 
 
-async def randomAccess(ip, port, number, dict):
+def randomValue(length):
+    return ''.join(
+        random.sample(string.ascii_letters + string.digits, length))
+
+
+# 每次使用流水线发送depth条指令，depth为1时等价于逐条发送
+async def randomAccess(ip, port, number, dict, depth=1):
     client = await getScacheclient(ip, port)
     print("{}:{} start: ", end=" ")
     print(int(round(time.time() * 1000)))
+    cmds = []
     for i in range(number):
         keyIndex = random.randint(0, len(dict) - 1)
         key = dict[keyIndex]
         ops = random.randint(0, 3)
         if (ops == 0):  # get
-            await client.getKeyValue(key)
-            continue
-        if (ops == 1):  # update
-            valueLength = random.randint(24, 32)
-            value = random.sample(string.ascii_letters + string.digits,
-                                  valueLength)
-            await client.setKeyValue(key, value)
-            continue
-        if (ops == 2):  # add
-            key = random.sample(string.ascii_letters + string.digits, 8)
-            valueLength = random.randint(24, 32)
-            value = random.sample(string.ascii_letters + string.digits,
-                                  valueLength)
-            await client.setKeyValue(key, value)
+            cmds.append("get {}".format(key))
+        elif (ops == 1):  # update
+            value = randomValue(random.randint(24, 32))
+            cmds.append("set {} {}".format(key, value))
+        elif (ops == 2):  # add
+            key = randomValue(8)
+            value = randomValue(random.randint(24, 32))
+            cmds.append("set {} {}".format(key, value))
             dict[len(dict)] = key
-            continue
-        if (ops == 3):  # del
-            await client.delKeyValue(key)
+        else:  # del
+            cmds.append("del {}".format(key))
+        if len(cmds) >= depth or i == number - 1:
+            await client.pipeline(cmds)
+            cmds = []
     await client.close()
     print("{}:{} end: ", end=" ")
     print(int(round(time.time() * 1000)))
 
 
+# 热点计数器：所有客户端对少量key计数。counter使用incr，一次往返；
+# lockcounter使用lock、get、set、unlock，加锁失败时重试；cascounter使用
+# gets和cas，版本号改变时重试
+async def counterInit(ip, port, counters):
+    client = await getScacheclient(ip, port)
+    for i in range(counters):
+        await client.setKeyValue("counter:{}".format(i), 0)
+    await client.close()
+
+
+async def counterAccess(ip, port, number, scenario, counters):
+    client = await getScacheclient(ip, port)
+    for i in range(number):
+        key = "counter:{}".format(random.randint(0, counters - 1))
+        if scenario == "counter":
+            await client.incrKeyValue(key)
+            continue
+        if scenario == "cascounter":
+            while True:
+                _, version, value = (await client.getsKeyValue(key)).split()
+                result = await client.casKeyValue(key, version,
+                                                  int(value) + 1)
+                if result.startswith("ok"):
+                    break
+            continue
+        while not (await client.lockKeyValue(key)).startswith("ok"):
+            pass
+        value = await client.getKeyValue(key)
+        await client.setKeyValue(key, int(value[3:]) + 1)
+        await client.unlockKeyValue(key)
+    await client.close()
+
+
+# 吵闹的邻居：noisy个连接在单独的进程中不停发送深度为depth的流水线，
+# 每条指令读取一个较长的链表，只读取不解析结果；其余客户端逐条发送get，
+# 记录每条指令的延迟
+NOISY_LIST = "noisy:list"
+
+
+async def noisyInit(ip, port, length):
+    client = await getScacheclient(ip, port)
+    await client.delKeyValue(NOISY_LIST)
+    for i in range(0, length, 100):
+        values = [randomValue(16) for _ in range(min(100, length - i))]
+        await client.listAddKeyValue(NOISY_LIST, *values)
+    await client.close()
+
+
+async def noisyAccess(ip, port, depth, stop):
+    reader, writer = await openConnection(ip, port)
+    batch = ("lall {}\n".format(NOISY_LIST) * depth).encode()
+
+    async def discard():
+        while await reader.read(1 << 20):
+            pass
+
+    task = asyncio.ensure_future(discard())
+    while not stop.is_set():
+        writer.write(batch)
+        await writer.drain()
+    writer.close()
+    task.cancel()
+
+
+def runNoisy(opt, stop):
+    loop = asyncio.new_event_loop()
+    asyncio.set_event_loop(loop)
+    tasks = [
+        loop.create_task(noisyAccess(opt.ip, opt.port, opt.depth, stop))
+        for _ in range(opt.noisy)
+    ]
+    loop.run_until_complete(asyncio.wait(tasks))
+    loop.close()
+
+
+async def latencyAccess(ip, port, number, dict, latencies):
+    client = await getScacheclient(ip, port)
+    for i in range(number):
+        key = dict[random.randint(0, len(dict) - 1)]
+        start = time.perf_counter()
+        await client.getKeyValue(key)
+        latencies.append(time.perf_counter() - start)
+    await client.close()
+
+
+# 较长的值：所有客户端对-k个key读写长度为valueSize的值，一半get一半set
+async def largeInit(ip, port, counters, value):
+    client = await getScacheclient(ip, port)
+    for i in range(counters):
+        await client.setKeyValue("large:{}".format(i), value)
+    await client.close()
+
+
+async def largeAccess(ip, port, number, counters, value):
+    client = await getScacheclient(ip, port)
+    for i in range(number):
+        key = "large:{}".format(random.randint(0, counters - 1))
+        if i % 2 == 0:
+            await client.getKeyValue(key)
+        else:
+            await client.setKeyValue(key, value)
+    await client.close()
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
 opts = optparse.OptionParser()
 
 opts.add_option(
@@ -76,26 +188,159 @@ opts.add_option(
     help="IP address of cache server.")
 opts.add_option(
     "-p", "--port", action="store", type="int", help="Port of cache server.")
+opts.add_option(
+    "-u",
+    "--unixSocket",
+    action="store",
+    type="string",
+    help="Path of the unix domain socket of cache server, used instead of "
+    "ip and port.")
+opts.add_option(
+    "-P",
+    "--processes",
+    action="store",
+    type="int",
+    default=1,
+    help="Number of client processes, every process runs clientNumber "
+    "clients. Use more processes to saturate a multi-shard server.")
+opts.add_option(
+    "-d",
+    "--depth",
+    action="store",
+    type="int",
+    default=1,
+    help="Number of pipelined requests sent at once by every client.")
+opts.add_option(
+    "-s",
+    "--scenario",
+    action="store",
+    type="choice",
+    choices=[
+        "random", "counter", "lockcounter", "cascounter", "noisy", "large",
+        "latency"
+    ],
+    default="random",
+    help="random: mixed get/set/del; counter: incr on a few hot keys; "
+    "lockcounter: the same counters with lock/get/set/unlock; "
+    "cascounter: the same counters with gets/cas; noisy: clients send "
+    "get one by one while noisy connections flood the server, reports "
+    "the latency of the well-behaved clients; large: get/set values of "
+    "valueSize bytes on a few keys; latency: clients send get one by one "
+    "and the round-trip latency is reported.")
+opts.add_option(
+    "-k",
+    "--counters",
+    action="store",
+    type="int",
+    default=16,
+    help="Number of hot keys used by the counter scenarios.")
+opts.add_option(
+    "-N",
+    "--noisy",
+    action="store",
+    type="int",
+    default=8,
+    help="Number of flooding connections used by the noisy scenario, "
+    "every connection pipelines depth requests at once.")
+opts.add_option(
+    "-v",
+    "--valueSize",
+    action="store",
+    type="int",
+    default=16384,
+    help="Bytes of every value used by the large scenario.")
+opts.add_option(
+    "-l",
+    "--noisyList",
+    action="store",
+    type="int",
+    default=1000,
+    help="Length of the list read by every request of the noisy "
+    "connections.")
+
+
+
+# 每个进程使用独立的事件循环，返回该进程开始和结束的时间(ms)以及noisy、
+# latency场景中每条指令的延迟(s)
+def runClients(opt):
+    loop = asyncio.new_event_loop()
+    asyncio.set_event_loop(loop)
+
+    keyDict = {}
+    loop.run_until_complete(warmup(opt.ip, opt.port, opt.warmup, keyDict, 16))
+    value = randomValue(16) * (opt.valueSize // 16)
+    if opt.scenario == "large":
+        loop.run_until_complete(
+            largeInit(opt.ip, opt.port, opt.counters, value))
+    elif opt.scenario not in ("random", "noisy", "latency"):
+        loop.run_until_complete(counterInit(opt.ip, opt.port, opt.counters))
+
+    taskList = []
+    latencies = []
+
+    for i in range(opt.clientNumber):
+        if opt.scenario in ("noisy", "latency"):
+            task = latencyAccess(opt.ip, opt.port, opt.requestNumber, keyDict,
+                                 latencies)
+        elif opt.scenario == "large":
+            task = largeAccess(opt.ip, opt.port, opt.requestNumber,
+                               opt.counters, value)
+        elif opt.scenario == "random":
+            task = randomAccess(opt.ip, opt.port, opt.requestNumber, keyDict,
+                                opt.depth)
+        else:
+            task = counterAccess(opt.ip, opt.port, opt.requestNumber,
+                                 opt.scenario, opt.counters)
+        taskList.append(loop.create_task(task))
+
+    start = int(round(time.time() * 1000))
+    loop.run_until_complete(asyncio.wait(taskList))
+    end = int(round(time.time() * 1000))
+    loop.close()
+    return start, end, latencies
 
-opt, _ = opts.parse_args()
 
-loop = asyncio.get_event_loop()
+if __name__ == "__main__":
+    opt, _ = opts.parse_args()
+    if opt.unixSocket:
+        opt.ip, opt.port = opt.unixSocket, None
 
-keyDict = {}
-loop.run_until_complete(warmup(opt.ip, opt.port, opt.warmup, keyDict, 16))
+    noisy = None
+    if opt.scenario == "noisy" and opt.noisy > 0:
+        loop = asyncio.new_event_loop()
+        loop.run_until_complete(noisyInit(opt.ip, opt.port, opt.noisyList))
+        loop.close()
+        stop = multiprocessing.Event()
+        noisy = multiprocessing.Process(target=runNoisy, args=(opt, stop))
+        noisy.start()
+        # 等待吵闹的连接占满服务端
+        time.sleep(1)
 
-taskList = []
+    if opt.processes <= 1:
+        times = [runClients(opt)]
+    else:
+        with multiprocessing.Pool(opt.processes) as pool:
+            times = pool.map(runClients, [opt] * opt.processes)
 
-for i in range(opt.clientNumber):
-    taskList.append(
-        asyncio.ensure_future(
-            randomAccess(opt.ip, opt.port, opt.requestNumber, keyDict)))
+    if noisy:
+        stop.set()
+        noisy.join(5)
+        if noisy.is_alive():
+            noisy.terminate()
 
-start = int(round(time.time() * 1000))
-loop.run_until_complete(asyncio.wait(taskList))
-end = int(round(time.time() * 1000))
+    start = min(t[0] for t in times)
+    end = max(t[1] for t in times)
+    concurrency = opt.clientNumber * len(times)
+    qps = int(((concurrency * opt.requestNumber) / (end - start)) * 1000)
 
-qps = int(((opt.clientNumber * opt.requestNumber) / (end - start)) * 1000)
-concurrency = opt.clientNumber
+    print("QPS: {} Concurrency: {} Depth: {} Scenario: {}".format(
+        qps, concurrency, opt.depth, opt.scenario))
+    if opt.scenario == "large":
+        print("Value: {} bytes, {:.1f} MB/s".format(
+            opt.valueSize, qps * opt.valueSize / 1e6))
 
-print("QPS: {} Concurrency: {}".format(qps, concurrency))
+    latencies = sorted(x for t in times for x in t[2])
+    if latencies:
+        print("Latency(ms) p50: {:.3f} p99: {:.3f} max: {:.3f}".format(
+            percentile(latencies, 0.5) * 1000,
+            percentile(latencies, 0.99) * 1000, latencies[-1] * 1000))
@@ -3,9 +3,16 @@ import time
 import asyncio
 
 
+# port为None时ip为unix domain socket的路径
+async def openConnection(ip, port):
+    if port is None:
+        return await asyncio.open_unix_connection(ip)
+    return await asyncio.open_connection(ip, port)
+
+
 # 测试用客户端
 async def getScacheclient(ip, port):
-    reader, writer = await asyncio.open_connection(ip, port)
+    reader, writer = await openConnection(ip, port)
     return Scacheclient(reader, writer)
 
 
@@ -14,14 +21,23 @@ class Scacheclient:
         self.__reader = reader
         self.__writer = writer
 
+    # 每条指令以换行结尾
     async def __send(self, meg):
-        self.__writer.write(meg.encode())
+        self.__writer.write((meg + "\n").encode())
         await self.__writer.drain()
 
+    # 每个结果的格式为"<长度>\n<内容>"
     async def __recv(self):
-        result = await self.__reader.read(1024)
+        header = await self.__reader.readline()
+        result = await self.__reader.readexactly(int(header))
         return result.decode('utf-8')
 
+    # 流水线：一次发送多条指令，按照顺序返回所有结果
+    async def pipeline(self, cmds):
+        self.__writer.write(("\n".join(cmds) + "\n").encode())
+        await self.__writer.drain()
+        return [await self.__recv() for _ in cmds]
+
     async def close(self):
         self.__writer.close()
 
@@ -48,6 +64,59 @@ class Scacheclient:
         await self.__send(cmd)
         return await self.__recv()
 
+    async def getsKeyValue(self, key):
+        cmd = "gets {}".format(key)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def casKeyValue(self, key, version, value, expire=-1):
+        if (expire == -1):
+            cmd = "cas {} {} {}".format(key, version, value)
+        else:
+            cmd = "cas {} {} {} expire {}".format(key, version, value, expire)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def scan(self, cursor, count=10):
+        cmd = "scan {} count {}".format(cursor, count)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def multiGetKeyValue(self, *keys):
+        cmd = "mget " + " ".join(str(k) for k in keys)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def multiSetKeyValue(self, *pairs):
+        cmd = "mset " + " ".join("{} {}".format(k, v) for k, v in pairs)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def multiDelKeyValue(self, *keys):
+        cmd = "mdel " + " ".join(str(k) for k in keys)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def incrKeyValue(self, key):
+        cmd = "incr {}".format(key)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def decrKeyValue(self, key):
+        cmd = "decr {}".format(key)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def incrByKeyValue(self, key, delta):
+        cmd = "incrby {} {}".format(key, delta)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def decrByKeyValue(self, key, delta):
+        cmd = "decrby {} {}".format(key, delta)
+        await self.__send(cmd)
+        return await self.__recv()
+
     async def dictSetKeyValue(self, mainKey, viceKey, value):
         cmd = "dset {} {} {}".format(mainKey, viceKey, value)
         await self.__send(cmd)
@@ -63,6 +132,16 @@ class Scacheclient:
         await self.__send(cmd)
         return await self.__recv()
 
+    async def dictIncrByKeyValue(self, mainKey, viceKey, delta):
+        cmd = "dincrby {} {} {}".format(mainKey, viceKey, delta)
+        await self.__send(cmd)
+        return await self.__recv()
+
+    async def dictScanKeyValue(self, mainKey, cursor, count=10):
+        cmd = "dscan {} {} count {}".format(mainKey, cursor, count)
+        await self.__send(cmd)
+        return await self.__recv()
+
     async def listAddKeyValue(self, mainKey, *value):
         cmd = "ladd {}".format(mainKey)
         for v in value:
@@ -85,6 +164,11 @@ class Scacheclient:
         await self.__send(cmd)
         return await self.__recv()
 
+    async def listRangeKeyValue(self, mainKey, start, stop):
+        cmd = "lrange {} {} {}".format(mainKey, start, stop)
+        await self.__send(cmd)
+        return await self.__recv()
+
     async def lockKeyValue(self, key):
         cmd = "lock {}".format(key)
         await self.__send(cmd)
@@ -0,0 +1,121 @@
+// 连接超时开销测试：每个连接一个deadline_timer(旧的实现)对比每个I/O线程
+// 一个IdleWheel，模拟大量连接建立、读取数据刷新最后访问时间、超时检查
+// 以及断开连接，输出每次操作的耗时(ns)。只测试定时器本身，不使用socket，
+// 不受打开文件数量的限制。
+// 用法：timer-bench [连接数量]，默认100000个
+#include "bench-util.h"
+#include "cache-timer.h"
+#include "cache-tool.h"
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace bpt = boost::posix_time;
+
+const int64 DURATION = 1200000; // ms，sessionDuration的默认值
+const int64 READS = 10000000;
+
+struct TimerResult {
+    double arm, refresh, check, cancel;
+};
+
+// 旧的实现：每个连接一个deadline_timer，到期时检查最后访问时间并重新设置
+static TimerResult runDeadlineTimer(int64 count) {
+    TimerResult result;
+    boost::asio::io_service ioService;
+    std::vector<std::unique_ptr<boost::asio::deadline_timer>> timers;
+    std::vector<int64> lastAccess(count, getCurrentTime());
+    int64 checked = 0;
+    std::function<void(int64, int64)> arm = [&](int64 i, int64 time) {
+        timers[i]->expires_from_now(bpt::millisec(time));
+        timers[i]->async_wait([&, i](const boost::system::error_code &ec) {
+            if (ec) return;
+            checked++;
+            auto interval = getCurrentTime() - lastAccess[i];
+            arm(i, DURATION - interval);
+        });
+    };
+
+    auto start = Clock::now();
+    for (int64 i = 0; i < count; i++) {
+        timers.emplace_back(new boost::asio::deadline_timer(ioService));
+        arm(i, DURATION);
+    }
+    result.arm = elapsedNs(start, count);
+
+    start = Clock::now();
+    for (int64 i = 0; i < READS; i++) {
+        lastAccess[i % count] = getCurrentTime();
+    }
+    result.refresh = elapsedNs(start, READS);
+
+    // 所有定时器立即到期一次，处理函数重新设置定时器。修改到期时间会取消
+    // 原来的等待，被取消的处理函数也在计时的poll中执行，和旧的实现中
+    // 连接关闭时取消定时器的开销相当
+    for (int64 i = 0; i < count; i++) arm(i, 0);
+    start = Clock::now();
+    while (checked < count) ioService.poll();
+    result.check = elapsedNs(start, count);
+
+    start = Clock::now();
+    for (auto& timer : timers) timer.reset();
+    ioService.poll();
+    result.cancel = elapsedNs(start, count);
+    return result;
+}
+
+// IdleWheel：读取数据只使用缓存的时钟，槽位到期时才检查连接
+static TimerResult runIdleWheel(int64 count) {
+    TimerResult result;
+    int64 now = IdleWheel::now();
+    IdleWheel wheel(DURATION, now);
+    std::vector<IdleNode> nodes(count);
+    std::vector<int64> lastAccess(count, now);
+
+    auto start = Clock::now();
+    for (int64 i = 0; i < count; i++) {
+        wheel.schedule(&nodes[i], now + DURATION + wheel.getTickSize());
+    }
+    result.arm = elapsedNs(start, count);
+
+    start = Clock::now();
+    for (int64 i = 0; i < READS; i++) {
+        lastAccess[i % count] = wheel.getNow();
+    }
+    result.refresh = elapsedNs(start, READS);
+
+    // 推进一个sessionDuration，每个连接被检查一次并重新放入时间轮
+    int64 end = now + DURATION + 2 * wheel.getTickSize();
+    int64 checked = 0;
+    start = Clock::now();
+    for (int64 time = now; time <= end; time += wheel.getTickSize()) {
+        checked += wheel.advance(time, [&](IdleNode* node) {
+            wheel.schedule(node, wheel.getNow() + DURATION);
+        });
+    }
+    result.check = elapsedNs(start, checked);
+
+    start = Clock::now();
+    for (auto& node : nodes) IdleWheel::remove(&node);
+    result.cancel = elapsedNs(start, count);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int64 count = argc > 1 ? std::atoll(argv[1]) : 100000;
+    auto timer = runDeadlineTimer(count);
+    auto wheel = runIdleWheel(count);
+    std::printf("connections: %lld, ns per operation\n", count);
+    std::printf("%-16s %10s %10s %10s %10s\n", "", "arm", "refresh",
+        "check", "cancel");
+    std::printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", "deadline_timer",
+        timer.arm, timer.refresh, timer.check, timer.cancel);
+    std::printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", "IdleWheel",
+        wheel.arm, wheel.refresh, wheel.check, wheel.cancel);
+    std::printf("per-session memory: deadline_timer %zu bytes + pending "
+        "handler, IdleNode %zu bytes\n",
+        sizeof(boost::asio::deadline_timer), sizeof(IdleNode));
+    return 0;
+}
@@ -2,6 +2,10 @@
 #include "cache-dict.h"
 #include "cache-list.h"
 #include "cache-tool.h"
+#include <charconv>
+#include <cstddef>
+#include <new>
+#include <utility>
 
 
 CacheType CacheBase::getType(){
@@ -9,61 +13,196 @@ CacheType CacheBase::getType(){
 }
 
 
-CacheValue::~CacheValue() {
-    switch (getType()) {
-    case StringType:
-        delete (std::string*)m_value;
-        break;
+size_t CacheString::allocSize(size_t size) {
+    return offsetof(CacheString, m_data) + size;
+}
+
+CacheString* CacheString::create(const char* data, size_t size) {
+    auto str = (CacheString*)::operator new(allocSize(size));
+    new (&str->m_refs) std::atomic<uint32_t>(1);
+    str->m_size = (uint32_t)size;
+    std::memcpy(str->m_data, data, size);
+    return str;
+}
+
+void CacheString::destroy(CacheString* str) {
+    // 只有一个引用时没有其他线程可以再增加引用，不需要原子的减法
+    if (str->m_refs.load(std::memory_order_acquire) != 1 &&
+        str->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    ::operator delete(str);
+}
+
+
+CacheStringRef::CacheStringRef(CacheString* str) : m_str(str) {
+    if (m_str) m_str->m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+CacheStringRef::CacheStringRef(const CacheStringRef& other)
+    : CacheStringRef(other.m_str) {}
+
+CacheStringRef::CacheStringRef(CacheStringRef&& other) noexcept
+    : m_str(other.m_str) {
+    other.m_str = nullptr;
+}
+
+CacheStringRef& CacheStringRef::operator=(CacheStringRef other) noexcept {
+    std::swap(m_str, other.m_str);
+    return *this;
+}
+
+CacheStringRef::~CacheStringRef() {
+    if (m_str) CacheString::destroy(m_str);
+}
+
+
+CacheType CacheValue::getType() const {
+    switch (getTag()) {
+    case LongTag:
+        return LongType;
+    case ListTag:
+        return ListType;
+    case DictTag:
+        return DictType;
     default:
-        break;    
+        return StringType;
     }
 }
 
-std::string CacheValue::getValue() {
-    if (getType() == LongType) {
-        return std::to_string((int64)(m_value));
+std::string CacheValue::getValue() const {
+    switch (getTag()) {
+    case LongTag:
+        return std::to_string(getLong());
+    case InlineTag:
+        return std::string(m_data, (uint8_t)m_data[22]);
+    case StringTag: {
+        auto str = load<CacheString*>();
+        return std::string(str->m_data, str->m_size);
     }
-    if (!m_value)return "";
-    return *(std::string*)m_value;
+    default:
+        return "";
+    }
+}
+
+// 可以转换为整型数，并且整型数转换回字符串之后和原来的字节相同。
+// "007"、"+5"、"-0"等按照字符串存储，读取时保持原样
+static bool toCanonicalNumber(std::string_view value, int64& number) {
+    if (!toNumber(value, number)) return false;
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    return std::string_view(buffer, result.ptr - buffer) == value;
 }
 
-void CacheValue::setValue(std::string value) {
-    if (getType() == LongType) {
-        int64 temp = std::stoll(value);
-        m_value = (void*)temp;
+void CacheValue::setValue(std::string_view value) {
+    release();
+    int64 number = 0;
+    if (toCanonicalNumber(value, number)) {
+        setLong(number);
         return;
     }
-    if (!m_value) m_value = new std::string();
-    *(std::string*)m_value = value;
+    if (value.size() <= INLINE_SIZE) {
+        std::memcpy(m_data, value.data(), value.size());
+        m_data[22] = (char)value.size();
+        setTag(InlineTag);
+        return;
+    }
+    store(CacheString::create(value.data(), value.size()));
+    setTag(StringTag);
+}
+
+size_t CacheValue::getStringSize() const {
+    return getTag() == StringTag ? load<CacheString*>()->m_size : 0;
+}
+
+CacheStringRef CacheValue::getString() const {
+    if (getTag() != StringTag) return CacheStringRef();
+    return CacheStringRef(load<CacheString*>());
+}
+
+int64 CacheValue::getMemory() const {
+    switch (getTag()) {
+    case StringTag:
+        return (int64)CacheString::allocSize(load<CacheString*>()->m_size);
+    case ListTag:
+    case DictTag:
+        return getObject()->getMemory();
+    default:
+        return 0;
+    }
+}
+
+void CacheValue::setObject(CacheBase* object) {
+    store(object);
+    setTag(object->getType() == ListType ? ListTag : DictTag);
+}
+
+void CacheValue::release() {
+    switch (getTag()) {
+    case StringTag:
+        CacheString::destroy(load<CacheString*>());
+        break;
+    case ListTag:
+    case DictTag:
+        delInstance(getObject());
+        break;
+    default:
+        break;
+    }
+    m_data[22] = 0;
+    setTag(InlineTag);
+}
+
+// 超过短字符串优化长度的std::string需要额外的堆上内存
+int64 cacheMemory(const std::string& str) {
+    return str.capacity() > 15 ? (int64)str.capacity() + 1 : 0;
+}
+
+int64 cacheMemory(const CacheValue& value) {
+    return value.getMemory();
+}
+
+CacheBase* newInstance(CacheType type) {
+    switch (type) {
+    case ListType:
+        return new ValueList();
+    case DictType:
+        return new ValueDict();
+    default:
+        return nullptr;
+    }
 }
 
 // 作为通用的容器模板，CacheDict和CacheList在析构时
 // 不会同时析构其中管理的堆上对象，其中子对象需要手动回收
 void delInstance(CacheBase* base) {
-    using CacheList = CacheList<CacheValue*>;
-    using NodeType = CacheList::NodeType;
-    using CacheDict = CacheDict<std::string,
-        CacheValue*>;
-    using PairType = CacheDict::PairType;
+    using NodeType = ValueList::NodeType;
+    using PairType = ValueDict::PairType;
 
     if (base->getType() == ListType) {
-        auto list = dynamic_cast<CacheList*>(base);
+        auto list = dynamic_cast<ValueList*>(base);
         std::function<void(const NodeType*)> func =
             [](const NodeType* x) {
-            delInstance(x->getValue());
+            CacheValue value = x->getValue();
+            delInstance(value);
         };
         list->walk(func);
         delete base; return;
     }
 
     if (base->getType() == DictType) {
-        auto dict = dynamic_cast<CacheDict*>(base);
+        auto dict = dynamic_cast<ValueDict*>(base);
         std::function<void(const PairType&)> func=
             [](const PairType& x) {
-            delInstance(x.m_two);
+            CacheValue value = x.m_two;
+            delInstance(value);
         };
         dict->walk(func);
         delete base; return;
     }
     delete base;
-}
\ No newline at end of file
+}
+
+void delInstance(CacheValue& value) {
+    value.release();
+}
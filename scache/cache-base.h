@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
 
 enum CacheType { DictType, ListType, LongType, StringType };
 
@@ -15,38 +19,115 @@ protected:
     virtual ~CacheBase() = default;
 public:
     CacheType getType();
+    // 容器本身以及其中所有数据占用的内存
+    virtual int64 getMemory() { return 0; }
 
     friend void delInstance(CacheBase* base);
 };
 
+// 超过CacheValue内联长度的字符串：引用计数、长度和数据在同一次分配中。
+// CacheValue持有一个引用，等待写回的结果可以持有更多的引用(CacheStringRef)
+struct CacheString {
+    std::atomic<uint32_t> m_refs;
+    uint32_t m_size;
+    char m_data[1];
+
+    static CacheString* create(const char* data, size_t size);
+    // 减少一个引用，最后一个引用释放时回收
+    static void destroy(CacheString* str);
+    static size_t allocSize(size_t size);
+};
+
+// CacheString的引用：结果直接引用缓存中存储的值，值在写回之前被修改或者
+// 删除也不会被回收。引用在执行线程中创建，可能在I/O线程中释放
+class CacheStringRef {
+private:
+    CacheString* m_str = nullptr;
+
+public:
+    CacheStringRef() = default;
+    explicit CacheStringRef(CacheString* str);
+    CacheStringRef(const CacheStringRef& other);
+    CacheStringRef(CacheStringRef&& other) noexcept;
+    CacheStringRef& operator=(CacheStringRef other) noexcept;
+    ~CacheStringRef();
+
+    explicit operator bool() const { return m_str != nullptr; }
+    const char* data() const { return m_str ? m_str->m_data : nullptr; }
+    size_t size() const { return m_str ? m_str->m_size : 0; }
+};
+
+// 带标记的值，固定24字节，没有虚函数表。整型数和不超过22字节的字符串
+// 直接存储在对象内部；较长的字符串存储在一个CacheString中；链表和字典
+// 存储其指针。CacheValue只是一个可以随意拷贝的句柄，和CacheList、
+// CacheDict一样不负责回收堆上对象，需要使用delInstance显式回收。
+class CacheValue {
+public:
+    static const int INLINE_SIZE = 22;
 
-class CacheValue : public CacheBase {
 private:
-    void *m_value = nullptr;
+    enum ValueTag : uint8_t {
+        LongTag, InlineTag, StringTag, ListTag, DictTag
+    };
+
+    // m_data[0..21]存储内联字符串或者整型数/指针，m_data[22]为内联
+    // 字符串长度，m_data[23]为标记
+    alignas(8) char m_data[24];
+
+    ValueTag getTag() const { return (ValueTag)m_data[23]; }
+    void setTag(ValueTag tag) { m_data[23] = (char)tag; }
+
+    template<class T> T load() const {
+        T temp; std::memcpy(&temp, m_data, sizeof(T)); return temp;
+    }
+    template<class T> void store(T temp) {
+        std::memcpy(m_data, &temp, sizeof(T));
+    }
 
 public:
-    CacheValue(CacheType valueType)
-        : CacheBase(valueType) { ; }
-    virtual ~CacheValue();
+    CacheValue() { m_data[22] = 0; setTag(InlineTag); }
+
+    CacheType getType() const;
+
+    // 返回字符串形式的数据，整型数转换为字符串
+    std::string getValue() const;
+    // 可以转换为整型数的字符串按照整型数存储
+    void setValue(std::string_view value);
+    // 单独分配的字符串的长度，其他类型为0
+    size_t getStringSize() const;
+    // 单独分配的字符串的引用，其他类型返回空引用
+    CacheStringRef getString() const;
+
+    int64 getLong() const { return load<int64>(); }
+    void setLong(int64 value) { store(value); setTag(LongTag); }
 
-    std::string getValue();
+    CacheBase* getObject() const { return load<CacheBase*>(); }
+    void setObject(CacheBase* object);
 
-    void setValue(std::string value);
+    // CacheValue本身之外占用的堆上内存，链表和字典包括其中所有数据
+    int64 getMemory() const;
+
+    // 回收字符串或者链表/字典，之后值为空字符串
+    void release();
 };
 
+// 容器中数据在节点之外占用的内存，CacheList和CacheDict用于统计内存
+template<class T> int64 cacheMemory(const T&) { return 0; }
+int64 cacheMemory(const std::string& str);
+int64 cacheMemory(const CacheValue& value);
+
+template<class T> class CacheList;
+template<class K, class V> class CacheDict;
+
+using ValueList = CacheList<CacheValue>;
+using ValueDict = CacheDict<std::string, CacheValue>;
+
+// 缓存对象的实际创建在cache-base.cpp中完成，此处CacheList和CacheDict
+// 尚未定义
+CacheBase* newInstance(CacheType type);
+
 template<class T> T* getInstance(CacheType type) {
-    switch (type) {
-    case StringType:
-        return (T*)(new CacheValue(StringType));
-    case LongType:
-        return (T*)(new CacheValue(LongType));
-    case ListType:
-        return (T*)(new CacheList<CacheValue*>());
-    case DictType:
-        return (T*)(new CacheDict<std::string,
-            CacheValue*>());
-    default:
-        return nullptr;
-    }
+    return (T*)newInstance(type);
 }
-void delInstance(CacheBase* base);
\ No newline at end of file
+void delInstance(CacheBase* base);
+void delInstance(CacheValue& value);
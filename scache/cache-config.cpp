@@ -1,5 +1,7 @@
 #include"cache-config.h"
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <thread>
 
 namespace bpo = boost::program_options;
 
@@ -21,21 +23,66 @@ void initGlobalConfig(int argc, char** argv) {
         ("listeningPort,p", 
             bpo::value<int16>(&config->listeningPort)->default_value(2333),
             "Listening port.")
+        ("respPort,R",
+            bpo::value<int16>(&config->respPort)->default_value(0),
+            "Listening port of RESP2 protocol(redis clients), 0 is "
+            "disabled.")
+        ("unixSocket,U",
+            bpo::value<std::string>(&config->unixSocket)->default_value(""),
+            "Path of the unix domain socket listener(text protocol), empty "
+            "is disabled.")
+        ("shardCount,w",
+            bpo::value<int64>(&config->shardCount)->default_value(0),
+            "The number of shards(executor threads), 0 is the number of "
+            "CPU cores.")
+        ("ioThreadCount,i",
+            bpo::value<int64>(&config->ioThreadCount)->default_value(0),
+            "The number of I/O threads, 0 is the number of CPU cores.")
         ("maxCacheSize,m", 
             bpo::value<int64>(&config->maxCacheSize)->default_value(1000000),
             "The maximum number of key-value pairs that can be stored.")
+        ("maxMemory,M",
+            bpo::value<int64>(&config->maxMemory)->default_value(0),
+            "The maximum bytes of memory used by cache data, 0 is unlimited.")
+        ("evictionPolicy,e",
+            bpo::value<std::string>(&config->evictionPolicy)
+                ->default_value("allkeys-lru"),
+            "Eviction policy: allkeys-lru, volatile-lru, allkeys-random, "
+            "noeviction or tinylfu.")
+        ("lruMode,r",
+            bpo::value<std::string>(&config->lruMode)
+                ->default_value("exact"),
+            "LRU mode: exact or approx(sampled eviction, reads do not "
+            "move list nodes).")
+        ("lruSamples,n",
+            bpo::value<int64>(&config->lruSamples)->default_value(5),
+            "The number of keys sampled per eviction in approx LRU mode.")
         ("expireCycle,c", 
-            bpo::value<int64>(&config->expireCycle)->default_value(15000),
-            "The period(ms) in which the key-value is checked for expiration.")
+            bpo::value<int64>(&config->expireCycle)->default_value(100),
+            "The period(ms) in which expired key-values are reclaimed.")
+        ("expireBudget,u",
+            bpo::value<int64>(&config->expireBudget)->default_value(10000),
+            "The maximum time(us) spent reclaiming expired key-values in a "
+            "cycle.")
         ("expireCount,t",
             bpo::value<int64>(&config->expireCount)->default_value(1000),
-            "The maximum number of key-value that be checked in a cycle.")
+            "The maximum number of key-value checked to find a volatile-lru "
+            "victim.")
         ("requestBufferSize,b", 
             bpo::value<int64>(&config->requestBufferSize)->default_value(20000),
             "The maximum number of requests that can be buffered.")
         ("sessionBufferSize,s",
             bpo::value<int64>(&config->sessionBufferSize)->default_value(4096),
             "The maxinum bytes of session that can be buffered.")
+        ("maxRequestSize,x",
+            bpo::value<int64>(&config->maxRequestSize)
+                ->default_value(1 << 26),
+            "The maximum bytes of a request, the session is closed when it "
+            "is exceeded.")
+        ("sessionPipeline,q",
+            bpo::value<int64>(&config->sessionPipeline)->default_value(1024),
+            "The maximum number of in-flight requests of a session, reading "
+            "is paused when it is reached.")
         ("sessionDuration,d", 
             bpo::value<int64>(&config->sessionDuration)->default_value(1200000),
             "Duration(ms) of session.")
@@ -46,4 +93,17 @@ void initGlobalConfig(int argc, char** argv) {
     bpo::variables_map parameterTable;
     bpo::store(bpo::parse_command_line(argc, argv, desc), parameterTable);
     parameterTable.notify();
+
+    if (config->shardCount <= 0) {
+        config->shardCount = std::max<int64>(1,
+            std::thread::hardware_concurrency());
+    }
+    config->sessionPipeline = std::max<int64>(1, config->sessionPipeline);
+    // 字符串值的长度使用32位存储
+    config->maxRequestSize = std::min<int64>(UINT32_MAX,
+        std::max(config->sessionBufferSize, config->maxRequestSize));
+    if (config->ioThreadCount <= 0) {
+        config->ioThreadCount = std::max<int64>(1,
+            std::thread::hardware_concurrency());
+    }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include<cstdint>
+#include<string>
 
 using int64 = long long;
 using int32 = int32_t;
@@ -14,11 +15,31 @@ private:
     virtual ~GlobalConfig() = default;
 public:
     int16 listeningPort = 2333;
+    // RESP2协议的监听端口，0表示不监听
+    int16 respPort = 0;
+    // unix domain socket的路径，使用文本协议，空表示不监听
+    std::string unixSocket = "";
+    // 分片数量，每个分片有独立的SimpleCache、RequestBuffer和执行线程，
+    // 0表示CPU核数。maxCacheSize和maxMemory平均分配到各个分片
+    int64 shardCount = 0; // 个
+    // I/O线程数量，每个线程有独立的io_service和监听socket，0表示CPU核数
+    int64 ioThreadCount = 0; // 个
     int64 maxCacheSize = 1000000; // 个
-    int64 expireCycle = 15000; // ms
-    int64 expireCount = 1000; // 个
+    int64 maxMemory = 0; // byte，0表示不限制
+    // allkeys-lru，volatile-lru，allkeys-random，noeviction，tinylfu
+    std::string evictionPolicy = "allkeys-lru";
+    // exact：读写都移动LRU链表节点；approx：只记录访问时间，淘汰时采样
+    std::string lruMode = "exact";
+    int64 lruSamples = 5; // 个，approx模式每次淘汰的采样数量
+    int64 expireCycle = 100; // ms
+    int64 expireBudget = 10000; // us，每个周期回收过期key最多使用的时间
+    int64 expireCount = 1000; // 个，volatile-lru最多检查的key数量
     int64 requestBufferSize = 20000; // 个
     int64 sessionBufferSize = 4096; // byte
+    // 一条指令的最大长度，超过时关闭连接。接收缓冲区按需扩大到该长度
+    int64 maxRequestSize = 1 << 26; // byte
+    // 一个连接中正在处理和等待写回的指令的上限，达到时暂停读取该连接
+    int64 sessionPipeline = 1024; // 个
     int64 sessionDuration = 1200000; // ms
     int64 lockDuration = 5000; // ms
 
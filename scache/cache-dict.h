@@ -3,7 +3,21 @@
 #include "cache-base.h"
 #include "cache-list.h"
 #include <functional>
-#include <iostream>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCACHE_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 template<class K,class V>
 struct CachePair {
@@ -13,259 +27,555 @@ struct CachePair {
     VType m_two;
 };
 
-template<class K,class V>
-class CacheDict : public CacheBase {
+// 控制字节：空槽位和删除槽位最高位为1，占用槽位保存哈希值低7位
+using CtrlType = int8_t;
+const CtrlType CTRL_EMPTY = -128;
+const CtrlType CTRL_DELETED = -2;
+const int64 GROUP_WIDTH = 16;
+
+// 预取即将访问的节点，隐藏随机访问的缓存未命中
+inline void cachePrefetch(const void* address) {
+#if defined(SCACHE_USE_SSE2)
+    _mm_prefetch((const char*)address, _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+inline int lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// 一组16个控制字节，使用SSE2一次比较整组，返回匹配槽位的位掩码
+class CacheGroup {
+private:
+    const CtrlType* m_ctrl;
+
 public:
-    using KType = K;
-    using VType = V ;
+    explicit CacheGroup(const CtrlType* ctrl) : m_ctrl(ctrl) { ; }
 
-    using PairType = CachePair<KType, VType>;
+#ifdef SCACHE_USE_SSE2
+    uint32_t match(CtrlType tag) const {
+        auto ctrl = _mm_loadu_si128((const __m128i*)m_ctrl);
+        return (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl));
+    }
+    uint32_t matchEmpty() const {
+        return match(CTRL_EMPTY);
+    }
+    // 空槽位和删除槽位都小于-1
+    uint32_t matchFree() const {
+        auto ctrl = _mm_loadu_si128((const __m128i*)m_ctrl);
+        return (uint32_t)_mm_movemask_epi8(
+            _mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+    }
+#else
+    uint32_t match(CtrlType tag) const {
+        uint32_t mask = 0;
+        for (int i = 0; i < GROUP_WIDTH; i++) {
+            if (m_ctrl[i] == tag) mask |= (1u << i);
+        }
+        return mask;
+    }
+    uint32_t matchEmpty() const {
+        return match(CTRL_EMPTY);
+    }
+    uint32_t matchFree() const {
+        uint32_t mask = 0;
+        for (int i = 0; i < GROUP_WIDTH; i++) {
+            if (m_ctrl[i] < -1) mask |= (1u << i);
+        }
+        return mask;
+    }
+#endif
+};
+
+// std::string类型的key使用std::string_view的哈希函数，两者对相同内容的
+// 哈希值相同，可以直接使用std::string_view查找
+template<class K>
+struct CacheHash : std::hash<K> { ; };
 
-    using BucketType = CacheList<PairType>;
-    using BucketNodeType = CacheListNode<PairType>;
+template<>
+struct CacheHash<std::string> : std::hash<std::string_view> { ; };
+
+// 开放寻址哈希表：控制字节数组 + 槽位数组，容量为2的幂，16个槽位为一组。
+// 组号取哈希值高位，组内标记取哈希值低7位，组间线性探测。槽位中保存完整
+// 哈希值和指向堆上节点的指针，rehash时只移动指针，已返回的节点不会失效。
+// 和CacheList一样只管理指针，不负责节点的回收。KeyOf用于从节点中取得key。
+template<class N, class KeyOf, class H>
+class CacheHashTable {
+public:
+    using NodeType = N;
 
     using SizeType = long long;
 
 private:
-    SizeType m_oldSize = -1;
-    SizeType m_nowSize = -1;
+    struct Slot {
+        uint64_t m_hash;
+        NodeType* m_node;
+    };
+
+    struct Table {
+        CtrlType* m_ctrl = nullptr;
+        Slot* m_slots = nullptr;
+        SizeType m_capacity = 0;
+        SizeType m_used = 0;
+        SizeType m_deleted = 0;
+        int m_shift = 64;
+    };
+
+    Table m_now;
+    Table m_old;
 
     SizeType m_useSize = 0;
 
-    BucketType** m_now = nullptr;
-    BucketType** m_old = nullptr;
-
     bool m_isRehash = false;
+    // 下一个待迁移的旧表分组
     SizeType m_rehash = -1;
 
-    double m_loadFactor = 1;
-    double m_growFactor = 2;
+    // 最大载入因子为 7/8，占用和删除槽位都计入
+    static const int m_loadNum = 7;
+    static const int m_loadDen = 8;
 
-    std::hash<KType> hash = std::hash<KType>{};
+    H hash = H{};
 
-    void rehashStep() {
-        BucketType* oldBucket= m_old[m_rehash];
-        if (!oldBucket) {
-            if ((--m_rehash) < 0) {
-                delete[] m_old;
-                m_old = nullptr; m_oldSize = -1;
-                m_isRehash = false;
+    template<class Q>
+    uint64_t hashOf(const Q& key) const {
+        uint64_t h = (uint64_t)hash(key);
+        h *= 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 32);
+    }
+
+    static void initTable(Table& table, SizeType capacity) {
+        SizeType size = 2 * GROUP_WIDTH;
+        int bits = 5;
+        while (size < capacity) { size <<= 1; bits++; }
+        table.m_ctrl = new CtrlType[size];
+        std::memset(table.m_ctrl, CTRL_EMPTY, size);
+        table.m_slots = new Slot[size];
+        table.m_capacity = size;
+        table.m_used = 0;
+        table.m_deleted = 0;
+        // 组号使用哈希值最高的(bits - 4)位
+        table.m_shift = 64 - (bits - 4);
+    }
+
+    static void freeTable(Table& table) {
+        delete[] table.m_ctrl;
+        delete[] table.m_slots;
+        table = Table();
+    }
+
+    // 未找到时通过freePos返回探测过程中遇到的第一个空闲槽位，插入时直接
+    // 使用，避免再次探测
+    template<class Q>
+    static Slot* findImpl(const Table& table, const Q& key, uint64_t h,
+        SizeType* freePos = nullptr) {
+        SizeType mask = (table.m_capacity / GROUP_WIDTH) - 1;
+        SizeType group = (SizeType)(h >> table.m_shift);
+        CtrlType tag = (CtrlType)(h & 0x7F);
+        for (SizeType probe = 0; probe <= mask; probe++) {
+            SizeType base = group * GROUP_WIDTH;
+            CacheGroup ctrl(table.m_ctrl + base);
+            for (uint32_t m = ctrl.match(tag); m; m &= m - 1) {
+                Slot* slot = table.m_slots + base + lowestBit(m);
+                if (slot->m_hash == h && KeyOf()(*slot->m_node) == key)
+                    return slot;
             }
-            return;
-        }
-        while (oldBucket->getSize() > 0) { 
-            auto node = oldBucket->popNode();
-            auto pos = hash(node->getValue().m_one) 
-                % (size_t)m_nowSize;
-            BucketType* nowBucket = m_now[pos];
-            if (!nowBucket)
-                m_now[pos] = new BucketType();
-            nowBucket = m_now[pos];
-            nowBucket->addNode(node);
-        }
-        delete oldBucket; m_old[m_rehash] = nullptr;
-        if ((--m_rehash) < 0) {
-            delete[] m_old; 
-            m_old = nullptr; m_oldSize = -1;
-            m_isRehash = false;
+            if (freePos && *freePos < 0) {
+                uint32_t m = ctrl.matchFree();
+                if (m) *freePos = base + lowestBit(m);
+            }
+            if (ctrl.matchEmpty()) return nullptr;
+            group = (group + 1) & mask;
         }
+        return nullptr;
     }
 
-    // 在rehash阶段进行set可能存在节点在两个数组之间的移动所以使用
-    // 单个函数来操作两个数组
-    void setImpl(PairType& pair) {
-        SizeType nowPos = hash(pair.m_one) % size_t(m_nowSize);
-        BucketType* nowBucket = m_now[nowPos];
-        if (!nowBucket) m_now[nowPos] = new BucketType();
-        nowBucket = m_now[nowPos];
-
-        std::function<bool(KType&, BucketNodeType*)> func =
-            [](KType& key, BucketNodeType* node) {
-            return node->getValue().m_one == key;
-        };
-
-        auto nowNode = nowBucket->getNode(pair.m_one, func);
-        if (nowNode) {
-            // m_now中存在，直接更新
-            nowNode->getValue().m_two = pair.m_two;
-            return;
-        }
-        // m_now中不存在且非rehash阶段：新数据直接添加
-        if (!m_isRehash) {
-            nowBucket->add(pair);
-            m_useSize++;
-            return;
-        }
-        // m_now中不存在且在rehash阶段：进一步搜索m_old
-        SizeType oldPos = hash(pair.m_one) % size_t(m_oldSize);
-        BucketType* oldBucket = m_old[oldPos];
-
-        if (!oldBucket) {
-            nowBucket->add(pair);
-            m_useSize++;
-            return;
+    static void placeImpl(Table& table, SizeType pos, NodeType* node,
+        uint64_t h) {
+        if (table.m_ctrl[pos] == CTRL_DELETED) table.m_deleted--;
+        table.m_ctrl[pos] = (CtrlType)(h & 0x7F);
+        table.m_slots[pos] = Slot{ h, node };
+        table.m_used++;
+    }
+
+    // 调用者保证key不在表中且表中仍有空闲槽位
+    static void insertImpl(Table& table, NodeType* node, uint64_t h) {
+        SizeType mask = (table.m_capacity / GROUP_WIDTH) - 1;
+        SizeType group = (SizeType)(h >> table.m_shift);
+        while (true) {
+            SizeType base = group * GROUP_WIDTH;
+            uint32_t m = CacheGroup(table.m_ctrl + base).matchFree();
+            if (m) {
+                placeImpl(table, base + lowestBit(m), node, h);
+                return;
+            }
+            group = (group + 1) & mask;
         }
-        
-        auto oldNode = oldBucket->getNode(pair.m_one, func);
-        if (oldNode) {
-            // m_old中存在：更新节点，调整节点位置
-            oldNode->getValue().m_two = pair.m_two;
-            oldBucket->popNode(oldNode);
-            nowBucket->addNode(oldNode);
+    }
+
+    // 所在分组中已有空槽位时，没有探测链会经过该组，可以直接置空
+    static void eraseImpl(Table& table, Slot* slot) {
+        SizeType pos = slot - table.m_slots;
+        SizeType base = pos - pos % GROUP_WIDTH;
+        if (CacheGroup(table.m_ctrl + base).matchEmpty()) {
+            table.m_ctrl[pos] = CTRL_EMPTY;
         }
         else {
-            nowBucket->add(pair);
-            m_useSize++;
+            table.m_ctrl[pos] = CTRL_DELETED;
+            table.m_deleted++;
         }
+        table.m_used--;
     }
 
-    PairType& getImpl(BucketType** arr, KType& key, SizeType arrSize) {
-        SizeType pos = hash(key) % (size_t)arrSize;
-        BucketType* bucket = arr[pos];
-        if (!bucket) {
-            throw std::string("Try get a Key not exist.");
+    // 每次迁移旧表中的一个分组，旧表中迁走的槽位标记为删除，保证旧表中
+    // 剩余数据的探测链完整
+    void rehashStep() {
+        SizeType base = m_rehash * GROUP_WIDTH;
+        for (SizeType pos = base; pos < base + GROUP_WIDTH; pos++) {
+            if (m_old.m_ctrl[pos] < 0) continue;
+            Slot& slot = m_old.m_slots[pos];
+            insertImpl(m_now, slot.m_node, slot.m_hash);
+            m_old.m_ctrl[pos] = CTRL_DELETED;
+            m_old.m_used--;
         }
-
-        std::function<bool(KType&, BucketNodeType*)> func =
-            [](KType& key, BucketNodeType* node) {
-            return node->getValue().m_one == key;
-        };
-
-        auto node = bucket->getNode(key,func);
-
-        if (!node) {
-            throw std::string("Try get a Key not exist.");
+        m_rehash++;
+        if (m_old.m_used <= 0 ||
+            m_rehash >= m_old.m_capacity / GROUP_WIDTH) {
+            freeTable(m_old);
+            m_isRehash = false;
+            m_rehash = -1;
         }
-        return node->getValue();
     }
 
-    void delImpl(BucketType** arr, KType& key, SizeType arrSize) {
-        SizeType pos = hash(key) % (size_t)arrSize;
-        BucketType* bucket = arr[pos];
-        if (!bucket) return;
-
-        std::function<bool(KType&, BucketNodeType*)> func = 
-            [](KType& key, BucketNodeType* node) {
-            return node->getValue().m_one == key;
-        };
+    // 占用和删除槽位超过载入因子时启动rehash；删除槽位较多时原大小重建
+    void startRehash() {
+        SizeType limit = m_now.m_capacity / m_loadDen * m_loadNum;
+        if (m_now.m_used + m_now.m_deleted < limit) return;
+        SizeType capacity = m_now.m_capacity;
+        if (m_now.m_used >= capacity / 2) capacity *= 2;
+        m_old = m_now;
+        initTable(m_now, capacity);
+        m_rehash = 0;
+        m_isRehash = true;
+    }
 
-        auto node = bucket->getNode(key, func);
-        if (!node) return;
-        bucket->pop(node);
-        m_useSize--;
+    static void prefetchGroup(const Table& table, uint64_t h) {
+        SizeType base = (SizeType)(h >> table.m_shift) * GROUP_WIDTH;
+        cachePrefetch(table.m_ctrl + base);
+        cachePrefetch(table.m_slots + base);
     }
 
-    bool hasImpl(BucketType** arr, KType& key, SizeType arrSize) {
-        SizeType pos = hash(key) % (size_t)arrSize;
-        BucketType* bucket = arr[pos];
-        if (!bucket) return false;
+    // 只检查第一个分组，冲突探测到后续分组的key在查找时再访问
+    static void prefetchSlot(const Table& table, uint64_t h) {
+        SizeType base = (SizeType)(h >> table.m_shift) * GROUP_WIDTH;
+        CacheGroup ctrl(table.m_ctrl + base);
+        for (uint32_t m = ctrl.match((CtrlType)(h & 0x7F)); m; m &= m - 1) {
+            const Slot* slot = table.m_slots + base + lowestBit(m);
+            if (slot->m_hash == h) cachePrefetch(slot->m_node);
+        }
+    }
 
-        std::function<bool(KType&, BucketNodeType*)> func =
-            [](KType& key, BucketNodeType* node) {
-            return node->getValue().m_one == key;
-        };
+    template<class Q>
+    Slot* findSlot(const Q& key, uint64_t h, Table** table = nullptr,
+        SizeType* freePos = nullptr) {
+        Slot* slot = findImpl(m_now, key, h, freePos);
+        if (table) *table = &m_now;
+        if (slot || !m_isRehash) return slot;
+        if (table) *table = &m_old;
+        return findImpl(m_old, key, h);
+    }
 
-        auto node = bucket->getNode(key,func);
-        if (!node) return false;
-        return true;
+    template<class F>
+    static int64 walkTable(const Table& table, F& func, int64 count,
+        int64 maxSize) {
+        for (SizeType i = 0; i < table.m_capacity; i++) {
+            if (count >= maxSize) break;
+            if (table.m_ctrl[i] < 0) continue;
+            func(table.m_slots[i].m_node);
+            count++;
+        }
+        return count;
     }
 
-public:
-    int64 walk(std::function<void(const PairType&)> func, 
-        int64 maxSize = LLONG_MAX) {
+    // 对哈希值在[low, high]中的节点调用func。节点可能沿着探测序列存放在
+    // 起始分组之后的分组中，从low所在的分组开始，访问到high所在的分组
+    // 之后继续，直到遇到含有空槽位的分组(查找时同样在这样的分组停止)
+    template<class F>
+    static int64 scanTable(const Table& table, uint64_t low, uint64_t high,
+        F& func) {
+        SizeType mask = (table.m_capacity / GROUP_WIDTH) - 1;
+        SizeType first = (SizeType)(low >> table.m_shift);
+        SizeType last = ((SizeType)(high >> table.m_shift) - first) & mask;
         int64 count = 0;
-        for (int64 i = 0; i < m_nowSize; i++) {
-            if (count >= maxSize)break;
-            BucketType* temp = m_now[i];
-            if (!temp || temp->getSize() <= 0)
-                continue;
-            BucketNodeType* node = temp->getHead()->getNext();
-            while (node) {
-                if (count >= maxSize)break;
-                func(node->getValue());
-                node = node->getNext();
+        for (SizeType probe = 0; probe <= mask; probe++) {
+            SizeType base = ((first + probe) & mask) * GROUP_WIDTH;
+            for (SizeType pos = base; pos < base + GROUP_WIDTH; pos++) {
+                if (table.m_ctrl[pos] < 0) continue;
+                uint64_t h = table.m_slots[pos].m_hash;
+                if (h < low || h > high) continue;
+                func(table.m_slots[pos].m_node);
                 count++;
             }
-        }
-        if (!m_isRehash) return count;
-        for (int64 i = 0; i < m_oldSize; i++) {
-            if (count >= maxSize)break;
-            BucketType* temp = m_old[i];
-            if (!temp || temp->getSize() <= 0)
-                continue;
-            BucketNodeType* node = temp->getHead()->getNext();
-            while (node) {
-                if (count >= maxSize)break;
-                func(node->getValue());
-                node = node->getNext();
-                count++;
+            if (probe >= last &&
+                CacheGroup(table.m_ctrl + base).matchEmpty()) {
+                break;
             }
         }
         return count;
     }
 
+public:
+    // 增量遍历：游标为哈希值，每次按照m_now一个分组对应的哈希值区间，依次
+    // 访问哈希值在[cursor, 区间末尾]中的节点(rehash时包括m_old中的节点)，
+    // 直到访问了count个节点或者count个区间，返回下一次调用的游标，返回0
+    // 时遍历结束。组号取哈希值高位，扩容只会把一个区间分成两个，游标在
+    // 扩容、rehash和删除前后都表示同一段哈希值，因此遍历期间一直存在的
+    // 节点恰好被访问一次。func参数为节点指针，不能修改哈希表
+    template<class F>
+    uint64_t scan(uint64_t cursor, int64 count, F func) {
+        uint64_t step = 1ull << m_now.m_shift;
+        int64 visited = 0;
+        for (int64 i = 0; i < count && visited < count; i++) {
+            uint64_t high = cursor | (step - 1);
+            visited += scanTable(m_now, cursor, high, func);
+            if (m_isRehash) visited += scanTable(m_old, cursor, high, func);
+            cursor = high + 1;
+            if (cursor == 0) break;
+        }
+        return cursor;
+    }
+
+    // func参数为节点指针，返回访问的节点数量
+    template<class F>
+    int64 walk(F func, int64 maxSize = LLONG_MAX) {
+        int64 count = walkTable(m_now, func, 0, maxSize);
+        if (!m_isRehash) return count;
+        return walkTable(m_old, func, count, maxSize);
+    }
 
-    CacheDict(SizeType initSize = 32) : CacheBase(DictType) {
-        m_now = new BucketType*[initSize]();
-        m_nowSize = initSize;
+    CacheHashTable(SizeType initSize = 32) {
+        initTable(m_now, initSize);
     }
-    virtual ~CacheDict() {
-        for (int i = 0; i < m_oldSize; i++) {
-            if (m_old[i]) delete m_old[i];
-        }
-        for (int i = 0; i < m_nowSize; i++) {
-            if (m_now[i]) delete m_now[i];
+    ~CacheHashTable() {
+        if (m_isRehash) freeTable(m_old);
+        freeTable(m_now);
+    }
+
+    // 查找key，不存在则使用create(key)创建新节点并插入，只探测一次。
+    // 通过isNew返回是否为新插入的节点
+    template<class Q, class F>
+    NodeType* emplace(const Q& key, bool& isNew, F create) {
+        if (m_isRehash) rehashStep();
+        else startRehash();
+        uint64_t h = hashOf(key);
+        SizeType freePos = -1;
+        Slot* slot = findSlot(key, h, nullptr, &freePos);
+        if (slot) {
+            isNew = false;
+            return slot->m_node;
         }
-        delete[] m_old;
-        delete[] m_now;
+        NodeType* node = create(key);
+        if (freePos >= 0) placeImpl(m_now, freePos, node, h);
+        else insertImpl(m_now, node, h);
+        m_useSize++;
+        isNew = true;
+        return node;
     }
 
-    void set(PairType& pair) {
-        setImpl(pair);
+    // 查找key，不存在时返回nullptr
+    template<class Q>
+    NodeType* find(const Q& key) {
+        if (m_isRehash) rehashStep();
+        Slot* slot = findSlot(key, hashOf(key));
+        return slot ? slot->m_node : nullptr;
+    }
 
-        if (m_useSize >= m_nowSize && !m_isRehash) {
-            m_old = m_now;
-            m_oldSize = m_nowSize;
-            m_now = new BucketType*[m_oldSize * m_growFactor]();
-            m_nowSize = m_oldSize * 2;
-            m_rehash = m_oldSize - 1;
-            m_isRehash = true;
-        }
+    // 使用prefetch返回的哈希值查找，不再重复计算
+    template<class Q>
+    NodeType* find(const Q& key, uint64_t h) {
         if (m_isRehash) rehashStep();
+        Slot* slot = findSlot(key, h);
+        return slot ? slot->m_node : nullptr;
     }
-    void del(KType key) {
-        delImpl(m_now, key, m_nowSize);
-        if (m_isRehash) {
-            delImpl(m_old, key, m_oldSize);
-            rehashStep();
-        } 
+
+    // 批量查找分两步预取：先对所有key调用prefetch计算哈希值并预取第一个
+    // 分组的控制字节和槽位，再对所有哈希值调用prefetchNode预取匹配的节点，
+    // 最后使用find(key, h)查找，多个key的缓存未命中可以同时进行
+    template<class Q>
+    uint64_t prefetch(const Q& key) const {
+        uint64_t h = hashOf(key);
+        prefetchGroup(m_now, h);
+        if (m_isRehash) prefetchGroup(m_old, h);
+        return h;
+    }
+
+    void prefetchNode(uint64_t h) const {
+        prefetchSlot(m_now, h);
+        if (m_isRehash) prefetchSlot(m_old, h);
     }
-    PairType& get(KType key) {
+
+    // 从表中移除key并返回对应节点，节点由调用者回收
+    template<class Q>
+    NodeType* remove(const Q& key) {
         if (m_isRehash) rehashStep();
-        std::string message;
-        try {
-            return getImpl(m_now, key, m_nowSize);
-        }
-        catch (std::string str) {
-            message = str;
-        }
-        if (!m_isRehash) throw message;
-        try {
-            return getImpl(m_old, key, m_oldSize);
+        Table* table = nullptr;
+        Slot* slot = findSlot(key, hashOf(key), &table);
+        if (!slot) return nullptr;
+        NodeType* node = slot->m_node;
+        eraseImpl(*table, slot);
+        m_useSize--;
+        return node;
+    }
+
+    SizeType getSize() { return m_useSize; }
+
+    // 从随机位置开始顺序收集最多count个节点写入nodes，返回实际数量。
+    // 连续的槽位只需要很少的缓存行，代价是样本之间并不独立。
+    // rehash时旧表中只有尚未迁移的分组还有数据，只在这部分中查找，
+    // 避免扫描大段已经迁走的槽位
+    int64 sample(uint64_t random, NodeType** nodes, int64 count) {
+        if (m_useSize <= 0 || count <= 0) return 0;
+        const Table* table = &m_now;
+        SizeType begin = 0;
+        if (m_isRehash && (SizeType)(random % m_useSize) < m_old.m_used) {
+            table = &m_old;
+            begin = m_rehash * GROUP_WIDTH;
         }
-        catch (std::string str) {
-            throw str;
+        count = count < table->m_used ? count : table->m_used;
+        SizeType size = table->m_capacity - begin;
+        SizeType pos = begin + (SizeType)((random >> 8) % size);
+        int64 found = 0;
+        while (found < count) {
+            if (table->m_ctrl[pos] >= 0)
+                nodes[found++] = table->m_slots[pos].m_node;
+            if (++pos >= table->m_capacity) pos = begin;
         }
+        return found;
     }
 
-    bool has(KType key) {
-        bool temp = hasImpl(m_now, key, m_nowSize);
-        if (m_isRehash && !temp) {
-            temp = hasImpl(m_old, key, m_oldSize);
-        }
-        if (m_isRehash) rehashStep();
-        return temp;
+    // 根据随机数random随机返回一个节点，表为空时返回nullptr
+    NodeType* sample(uint64_t random) {
+        NodeType* node = nullptr;
+        sample(random, &node, 1);
+        return node;
     }
 
-    SizeType getSize() { return m_useSize; }
-};
\ No newline at end of file
+    // 控制字节和槽位数组占用的内存，包括rehash中的旧表
+    int64 getMemory() {
+        int64 size = m_now.m_capacity + m_old.m_capacity;
+        return size * (int64)(sizeof(CtrlType) + sizeof(Slot));
+    }
+
+    SizeType getCapacity() { return m_now.m_capacity; }
+};
+
+template<class K, class V>
+struct CachePairKey {
+    const K& operator()(const CachePair<K, V>& pair) const {
+        return pair.m_one;
+    }
+};
+
+// 哈希表结构，key-value对使用CachePair存储在堆上
+template<class K,class V>
+class CacheDict : public CacheBase {
+public:
+    using KType = K;
+    using VType = V ;
+
+    using PairType = CachePair<KType, VType>;
+    using TableType = CacheHashTable<PairType, CachePairKey<KType, VType>,
+        CacheHash<KType>>;
+
+    using SizeType = long long;
+
+private:
+    TableType m_table;
+    // 所有CachePair及其中数据占用的内存
+    int64 m_memory = 0;
+
+    static int64 pairMemory(const PairType& pair) {
+        return sizeof(PairType) + cacheMemory(pair.m_one) +
+            cacheMemory(pair.m_two);
+    }
+
+public:
+    int64 walk(std::function<void(const PairType&)> func,
+        int64 maxSize = LLONG_MAX) {
+        return m_table.walk([&func](PairType* pair) { func(*pair); },
+            maxSize);
+    }
+
+    // 增量遍历，参考CacheHashTable::scan
+    template<class F>
+    uint64_t scan(uint64_t cursor, int64 count, F func) {
+        return m_table.scan(cursor, count,
+            [&func](PairType* pair) { func(*pair); });
+    }
+
+
+    CacheDict(SizeType initSize = 32) : CacheBase(DictType),
+        m_table(initSize) { ; }
+    virtual ~CacheDict() {
+        m_table.walk([](PairType* pair) { delete pair; });
+    }
+
+    // 插入或者更新
+    void set(const PairType& pair) {
+        bool isNew = false;
+        PairType* temp = emplace(pair.m_one, isNew);
+        update(temp, pair.m_two);
+    }
+
+    // 更新CachePair中的值，旧值中的堆上数据由调用者回收
+    void update(PairType* pair, const VType& value) {
+        m_memory += cacheMemory(value) - cacheMemory(pair->m_two);
+        pair->m_two = value;
+    }
+
+    // 查找key，不存在则插入一个值为默认值的新CachePair，只探测一次。
+    // 通过isNew返回是否为新插入的数据
+    template<class Q>
+    PairType* emplace(const Q& key, bool& isNew) {
+        PairType* pair = m_table.emplace(key, isNew, [](const Q& key) {
+            return new PairType{ KType(key), VType() };
+        });
+        if (isNew) m_memory += pairMemory(*pair);
+        return pair;
+    }
+
+    // 查找key，不存在时返回nullptr
+    template<class Q>
+    PairType* find(const Q& key) {
+        return m_table.find(key);
+    }
+
+    // 删除CachePair，值中的堆上数据由调用者回收
+    template<class Q>
+    bool del(const Q& key) {
+        PairType* pair = m_table.remove(key);
+        if (!pair) return false;
+        m_memory -= pairMemory(*pair);
+        delete pair;
+        return true;
+    }
+
+    template<class Q>
+    bool has(const Q& key) {
+        return find(key) != nullptr;
+    }
+
+    SizeType getSize() { return m_table.getSize(); }
+
+    int64 getMemory() override {
+        return sizeof(*this) + m_table.getMemory() + m_memory;
+    }
+};
@@ -0,0 +1,35 @@
+#include "cache-entry.h"
+#include <cstring>
+#include <new>
+
+CacheEntry::~CacheEntry() {
+    delete m_lock;
+}
+
+size_t CacheEntry::allocSize(size_t keySize) {
+    return sizeof(CacheEntry) + keySize;
+}
+
+CacheEntry* CacheEntry::create(std::string_view key) {
+    void* memory = ::operator new(allocSize(key.size()));
+    auto entry = new (memory) CacheEntry();
+    entry->m_keySize = (uint32_t)key.size();
+    std::memcpy(entry->keyData(), key.data(), key.size());
+    return entry;
+}
+
+void CacheEntry::destroy(CacheEntry* entry) {
+    entry->~CacheEntry();
+    ::operator delete((void*)entry);
+}
+
+void CacheEntry::setLock(uint64_t owner, int64 expireTime) {
+    if (!m_lock) m_lock = new ClientLock();
+    m_lock->m_owner = owner;
+    m_lock->m_expireTime = expireTime;
+}
+
+void CacheEntry::delLock() {
+    delete m_lock;
+    m_lock = nullptr;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "cache-base.h"
+#include "cache-list.h"
+#include <string>
+#include <string_view>
+
+// 客户端锁：加锁连接的句柄(SessionHandle)和锁的过期时间
+struct ClientLock {
+    uint64_t m_owner;
+    int64 m_expireTime;
+};
+
+class CacheEntry;
+
+// 过期时间：只有设置了过期时间的key才分配，同时作为时间轮槽位中双向
+// 链表的节点，由CacheTimerWheel管理
+struct ExpireNode {
+    int64 m_expireTime = 0;
+    ExpireNode* m_prev = nullptr;
+    ExpireNode* m_next = nullptr;
+    CacheEntry* m_entry = nullptr;
+};
+
+// W-TinyLFU中节点所在的区域，其他淘汰策略只使用WindowSegment
+enum CacheSegment : uint8_t {
+    WindowSegment, ProbationSegment, ProtectedSegment
+};
+
+// 一级key对应的全部数据，只需要一次内存分配：LRU链表节点(其中包括值)，
+// 过期时间，客户端锁，访问时间，版本号，key的字节紧跟在对象之后。
+// 使用create创建，使用destroy销毁，不会回收其中的值。
+class CacheEntry : public CacheListNode<CacheValue> {
+private:
+    // 大多数key没有设置过期时间，也没有加锁，二者单独分配
+    ExpireNode* m_expire = nullptr;
+    ClientLock* m_lock = nullptr;
+    // key长度和W-TinyLFU区域共用4字节，key最长为MAX_KEY_SIZE
+    uint32_t m_keySize : 24;
+    uint32_t m_segment : 8;
+    // 近似LRU使用的逻辑访问时间，占用m_keySize之后的对齐空间
+    uint32_t m_accessTime = 0;
+    // 值每次修改时由SimpleCache设置为分片内递增的版本号，用于cas
+    uint64_t m_version = 0;
+
+    CacheEntry() : m_keySize(0), m_segment(WindowSegment) { ; }
+    ~CacheEntry();
+
+    char* keyData() { return (char*)(this + 1); }
+    const char* keyData() const { return (const char*)(this + 1); }
+
+public:
+    static const uint32_t MAX_KEY_SIZE = (1 << 24) - 1;
+
+    static CacheEntry* create(std::string_view key);
+    static void destroy(CacheEntry* entry);
+
+    // 一个节点占用的内存(不包括值中的堆上数据)
+    static size_t allocSize(size_t keySize);
+
+    std::string_view getKey() const {
+        return std::string_view(keyData(), m_keySize);
+    }
+
+    // 过期时间，0表示未设置过期时间
+    int64 getExpireTime() const {
+        return m_expire ? m_expire->m_expireTime : 0;
+    }
+    ExpireNode* getExpireNode() const { return m_expire; }
+    void setExpireNode(ExpireNode* node) { m_expire = node; }
+
+    uint32_t getAccessTime() const { return m_accessTime; }
+    void setAccessTime(uint32_t time) { m_accessTime = time; }
+
+    uint64_t getVersion() const { return m_version; }
+    void setVersion(uint64_t version) { m_version = version; }
+
+    CacheSegment getSegment() const { return (CacheSegment)m_segment; }
+    void setSegment(CacheSegment segment) { m_segment = segment; }
+
+    ClientLock* getLock() const { return m_lock; }
+    void setLock(uint64_t owner, int64 expireTime);
+    void delLock();
+};
+
+struct CacheEntryKey {
+    std::string_view operator()(const CacheEntry& entry) const {
+        return entry.getKey();
+    }
+};
@@ -37,6 +37,9 @@ public:
 
 private:
     int64 m_size = 0;
+    // add添加、pop移除的节点及其数据占用的内存，addNode和popNode只调整
+    // 节点位置，不计入
+    int64 m_memory = 0;
     NodeType *m_head = nullptr;
     NodeType *m_tail = nullptr;
 
@@ -51,7 +54,7 @@ public:
     virtual ~CacheList() {
         NodeType *temp = m_head;
         NodeType *next = nullptr;
-        while (next = temp->getNext()) {
+        while ((next = temp->getNext()) != nullptr) {
             delete temp;
             temp = next;
         }
@@ -81,6 +84,7 @@ public:
     NodeType* add(ValueType& value) {
         auto node = new NodeType(value);
         addNode(node);
+        m_memory += sizeof(NodeType) + cacheMemory(value);
         return node;
     }
 
@@ -118,6 +122,7 @@ public:
             throw std::string("Try pop empty list.");
         }
         ValueType temp = node->getValue();
+        m_memory -= sizeof(NodeType) + cacheMemory(temp);
        
         delete node;
         return temp;
@@ -147,7 +152,26 @@ public:
         }
     }
 
+    // 从首部开始的第index个节点，从距离较近的一端开始查找，越界时返回
+    // nullptr
+    NodeType* getNodeAt(int64 index) {
+        if (index < 0 || index >= m_size) return nullptr;
+        NodeType* temp = nullptr;
+        if (index < m_size / 2) {
+            temp = m_head->getNext();
+            for (int64 i = 0; i < index; i++) temp = temp->getNext();
+        }
+        else {
+            temp = m_tail;
+            for (int64 i = m_size - 1; i > index; i--) temp = temp->getPrev();
+        }
+        return temp;
+    }
+
     NodeType* getHead() { return m_head; }
     NodeType* getTail() { return m_tail; }
     int64 getSize() { return m_size; }
+    int64 getMemory() override {
+        return sizeof(*this) + sizeof(NodeType) + m_memory;
+    }
 };
\ No newline at end of file
@@ -5,8 +5,14 @@
 #include "cache-base.h"
 #include "cache-tool.h"
 #include "cache-session.h"
+#include "request-resp.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
 // Command
@@ -14,19 +20,38 @@ const std::string SET_COMMAND = "set";
 const std::string GET_COMMAND = "get";
 const std::string EXPIRE_COMMAND = "expire";
 const std::string DEL_COMMAND = "del";
+const std::string GETS_COMMAND = "gets";
+const std::string CAS_COMMAND = "cas";
+const std::string SCAN_COMMAND = "scan";
+const std::string COUNT_COMMAND = "count";
+
+const std::string MGET_COMMAND = "mget";
+const std::string MSET_COMMAND = "mset";
+const std::string MDEL_COMMAND = "mdel";
+
+const std::string INCR_COMMAND = "incr";
+const std::string DECR_COMMAND = "decr";
+const std::string INCRBY_COMMAND = "incrby";
+const std::string DECRBY_COMMAND = "decrby";
 
 const std::string DSET_COMMAND = "dset";
 const std::string DGET_COMMAND = "dget";
 const std::string DDEL_COMMAND = "ddel";
+const std::string DINCRBY_COMMAND = "dincrby";
+const std::string DSCAN_COMMAND = "dscan";
 
 const std::string LADD_COMMAND = "ladd";
 const std::string LPOP_COMMAND = "lpop";
 const std::string LGET_COMMAND = "lget";
 const std::string LALL_COMMAND = "lall";
+const std::string LRANGE_COMMAND = "lrange";
 
 const std::string LOCK_COMMAND = "lock";
 const std::string UNLOCK_COMMAND = "unlock";
 
+const std::string INFO_COMMAND = "info";
+const std::string PING_COMMAND = "ping";
+
 // Error message
 const std::string WRONG_REQUEST_FORMAT = "error wrong request format";
 const std::string WRONG_REQUEST_COMMAND = "error wrong request command";
@@ -35,171 +60,528 @@ const std::string UNSUPPORTED_OPERATION = "error unsupported operation";
 const std::string KEY_VALUE_IS_LOCKED = "error key-value is locked";
 const std::string KEY_VALUE_IS_EXPIRED = "error key-value is expired";
 const std::string CONTAINER_IS_EMPTY = "error container is empty";
+const std::string OUT_OF_MEMORY = "error out of memory";
+const std::string VALUE_NOT_INTEGER = "error value is not an integer";
+const std::string INTEGER_OVERFLOW = "error integer overflow";
+const std::string VERSION_MISMATCH = "error version mismatch";
 
 // 标志过期时间任务
-const std::string EXPIRE_TASK = "expireTask";
+// 不属于任何连接的请求为定时过期任务
+const SessionHandle EXPIRE_TASK = INVALID_SESSION;
+
+// scan、dscan每次默认访问的数量，scan、dscan和lrange每次最多访问的数量
+const int64 SCAN_DEFAULT_COUNT = 10;
+const int64 SCAN_MAX_COUNT = 10000;
+// 遍历所有key时游标的低16位为分片序号，其余为分片内的游标
+const uint64_t SCAN_SHARD_MASK = 0xFFFF;
+
+// 指令名称不区分大小写，redis客户端使用大写的指令名称
+static bool isCommand(std::string_view name, const std::string& command) {
+    return name.size() == command.size() &&
+        std::equal(name.begin(), name.end(), command.begin(),
+            [](char a, char b) { return std::tolower((unsigned char)a) == b; });
+}
+
+// 执行线程所在的分片，其他线程为第0个分片
+static thread_local int64 currentShard = 0;
+
+// 近似LRU淘汰池大小，每轮最多采样数量以及一次淘汰最多的采样轮数
+const size_t EVICTION_POOL_SIZE = 16;
+const int64 EVICTION_MAX_SAMPLES = 64;
+const int64 EVICTION_MAX_ROUNDS = 16;
 
 SimpleCache::SimpleCache() {
-    m_expireTable = new ExpireTable();
-    m_clientLockTable = new ClientLockTable();
     m_linkedList = new LinkedList();
     m_cacheTable = new CacheTable();
+    m_timerWheel = new CacheTimerWheel(getCurrentTime());
+    m_lockTable = new LockTable();
     m_globalConfig = getGlobalConfig();
+    m_random.seed(getCurrentTime());
+
+    int64 shards = std::max<int64>(1, m_globalConfig->shardCount);
+    m_maxSize = m_globalConfig->maxCacheSize > 0 ?
+        std::max<int64>(1, m_globalConfig->maxCacheSize / shards) : 0;
+    m_maxMemory = m_globalConfig->maxMemory > 0 ?
+        std::max<int64>(1, m_globalConfig->maxMemory / shards) : 0;
+
+    std::map<std::string, EvictionPolicy> policies = {
+        {"allkeys-lru", AllKeysLru},
+        {"volatile-lru", VolatileLru},
+        {"allkeys-random", AllKeysRandom},
+        {"noeviction", NoEviction},
+        {"tinylfu", TinyLfu}};
+    auto it = policies.find(m_globalConfig->evictionPolicy);
+    if (it != policies.end()) {
+        m_policy = it->second;
+    }
+    else {
+        std::cout << "Unknown eviction policy: " +
+            m_globalConfig->evictionPolicy + ", use allkeys-lru."
+            << std::endl;
+    }
+    if (m_policy == TinyLfu) {
+        int64 maximum = m_maxSize > 0 ? m_maxSize : 1 << 20;
+        m_tinyLfu = new CacheTinyLfu(maximum);
+    }
+    if (m_globalConfig->lruMode == "approx" && m_tinyLfu) {
+        std::cout << "LRU mode approx is ignored by tinylfu." << std::endl;
+    }
+    else if (m_globalConfig->lruMode == "approx") {
+        m_approxLru = true;
+        m_evictionPool.reserve(EVICTION_POOL_SIZE);
+    }
+    else if (m_globalConfig->lruMode != "exact") {
+        std::cout << "Unknown LRU mode: " + m_globalConfig->lruMode +
+            ", use exact." << std::endl;
+    }
 }
 
 SimpleCache::~SimpleCache() {
-    delete m_clientLockTable;
-    delete m_expireTable;
-    // 销毁缓存中剩余一级对象
-    std::function<void(const NodeType*)> func=
-        [](const NodeType* x) {
-        delInstance(x->getValue());
-    };
-    m_linkedList->walk(func);
+    // 销毁缓存中剩余一级对象，节点先从链表中移除，链表只负责回收头节点
+    for (auto list : getLists()) {
+        NodeType* node = nullptr;
+        while ((node = list->popNode()) != nullptr) {
+            auto entry = static_cast<CacheEntry*>(node);
+            delInstance(entry->getValue());
+            CacheEntry::destroy(entry);
+        }
+    }
+    delete m_tinyLfu;
+    delete m_timerWheel;
+    delete m_lockTable;
+    delete m_linkedList;
     delete m_cacheTable;
 }
 
-// 更新或者插入对象，过期时间自动销毁，节点移动到链表首部
-void SimpleCache::set(std::string& key, CacheBase* value) {
-    try {
-        // key已经存在：更新
-        PairType& pair = m_cacheTable->get(key);
-        // 销毁存储旧对象
-        delInstance(pair.m_two.getValue());
-        pair.m_two.setValue(value);
-        // 销毁失效过期时间
-        m_expireTable->del(key);
-        // 将节点移动到链表首部
-        m_linkedList->popNode(&pair.m_two);
-        m_linkedList->addNode(&pair.m_two);
-    }
-    catch(std::string e){
-        // key不存在：插入新pair
-        auto temp = PairType {
-            key,
-            CacheListNode<CacheBase*>(value)
-        };
-        m_cacheTable->set(temp);
-        // 获取实际存储的pair的引用并提取其中value部分(ListNode部分)的指针
-        // 将新Node插入到链表中
-        PairType& pair = m_cacheTable->get(key);
-        m_linkedList->addNode(&pair.m_two);
+CacheEntry* SimpleCache::find(std::string_view key) {
+    return m_cacheTable->find(key);
+}
+
+CacheEntry* SimpleCache::find(std::string_view key, uint64_t hash) {
+    return m_cacheTable->find(key, hash);
+}
+
+// 先预取所有key的分组，再预取分组中匹配的节点，两轮之间的访存互相重叠
+const uint64_t* SimpleCache::prefetch(const std::string_view* keys,
+    int64 count, int64 stride) {
+    m_batchHashes.resize(count);
+    for (int64 i = 0; i < count; i++) {
+        m_batchHashes[i] = m_cacheTable->prefetch(keys[i * stride]);
+    }
+    for (int64 i = 0; i < count; i++) {
+        m_cacheTable->prefetchNode(m_batchHashes[i]);
+    }
+    return m_batchHashes.data();
+}
+
+CacheEntry* SimpleCache::emplace(std::string_view key, bool& isNew) {
+    auto entry = m_cacheTable->emplace(key, isNew,
+        [](std::string_view key) { return CacheEntry::create(key); });
+    if (isNew) {
+        // key不存在：新节点插入到链表首部
+        m_entryMemory += CacheEntry::allocSize(key.size());
+        updateVersion(entry);
+        if (m_tinyLfu) m_tinyLfu->add(entry);
+        else m_linkedList->addNode(entry);
+        entry->setAccessTime(++m_lruClock);
+        // key不存在时加的锁移入新节点
+        if (m_lockTable->getSize() > 0) {
+            auto pair = m_lockTable->find(key);
+            if (pair) {
+                entry->setLock(pair->m_two.m_owner, pair->m_two.m_expireTime);
+                m_lockTable->del(key);
+            }
+        }
     }
+    else {
+        touch(entry);
+    }
+    return entry;
+}
+
+// 更新或者插入对象，过期时间自动销毁，节点移动到链表首部，
+// 返回实际存储的对象
+CacheValue* SimpleCache::set(std::string_view key,
+    const CacheValue& value) {
+    bool isNew = false;
+    auto entry = emplace(key, isNew);
+    set(entry, value);
+    return &entry->getValue();
+}
+
+// 销毁存储旧对象，销毁失效过期时间
+void SimpleCache::set(CacheEntry* entry, const CacheValue& value) {
+    m_valueMemory += value.getMemory() - entry->getValue().getMemory();
+    delInstance(entry->getValue());
+    entry->setValue(value);
+    delExpire(entry);
+    updateVersion(entry);
+}
+
+void SimpleCache::updateVersion(CacheEntry* entry) {
+    entry->setVersion(++m_version);
 }
 
 // 返回对象，节点移动到链表首部
-CacheBase* SimpleCache::get(std::string& key) {
-    try {
-        auto& pair = m_cacheTable->get(key);
-        m_linkedList->popNode(&pair.m_two);
-        m_linkedList->addNode(&pair.m_two);
-        return pair.m_two.getValue();
-    }
-    catch (std::string e) {
-        return nullptr;
-    }
+CacheValue* SimpleCache::get(std::string_view key) {
+    auto entry = m_cacheTable->find(key);
+    if (!entry) return nullptr;
+    touch(entry);
+    return &entry->getValue();
+}
+
+// 删除对象，节点从链表移除，过期时间和客户端锁随节点一起销毁
+void SimpleCache::del(std::string_view key) {
+    auto entry = m_cacheTable->find(key);
+    if (entry) del(entry);
+}
+
+void SimpleCache::del(CacheEntry* entry) {
+    if (!m_evictionPool.empty()) {
+        auto& pool = m_evictionPool;
+        pool.erase(std::remove_if(pool.begin(), pool.end(),
+            [entry](const EvictionCandidate& x) {
+                return x.m_entry == entry; }), pool.end());
+    }
+    m_cacheTable->remove(entry->getKey());
+    m_timerWheel->remove(entry);
+    if (m_tinyLfu) m_tinyLfu->remove(entry);
+    else m_linkedList->popNode(entry);
+    m_entryMemory -= CacheEntry::allocSize(entry->getKey().size());
+    m_valueMemory -= entry->getValue().getMemory();
+    delInstance(entry->getValue());
+    CacheEntry::destroy(entry);
 }
 
-// 删除对象，过期时间自动销毁，节点从链表移除，客户端锁自动销毁
-void SimpleCache::del(std::string& key) {
-    try {
-        auto& pair = m_cacheTable->get(key);
-        m_linkedList->popNode(&pair.m_two);
-        delInstance(pair.m_two.getValue());
-        m_cacheTable->del(key);
-        m_clientLockTable->del(key);
-        m_expireTable->del(key);
+bool SimpleCache::has(std::string_view key) {
+    return m_cacheTable->find(key) != nullptr;
+}
+
+// approx模式下读操作只写节点自身，不修改前后节点和链表首部
+void SimpleCache::touch(CacheEntry* entry) {
+    if (m_tinyLfu) {
+        m_tinyLfu->touch(entry);
+        return;
     }
-    catch (std::string e) {
+    if (m_approxLru) {
+        entry->setAccessTime(++m_lruClock);
         return;
     }
+    m_linkedList->popNode(entry);
+    m_linkedList->addNode(entry);
 }
 
-bool SimpleCache::has(std::string& key) {
-    return m_cacheTable->has(key);
+int64 SimpleCache::getMemory(CacheEntry* entry) {
+    return entry->getValue().getMemory();
 }
 
-int64 SimpleCache::getSize() {
-    return m_cacheTable->getSize();
+void SimpleCache::account(CacheEntry* entry, int64 before) {
+    m_valueMemory += getMemory(entry) - before;
+    updateVersion(entry);
+}
+
+int64 SimpleCache::getUsedMemory() {
+    int64 sketchMemory = m_tinyLfu ? m_tinyLfu->getMemory() : 0;
+    return m_cacheTable->getMemory() + m_entryMemory + m_valueMemory +
+        m_timerWheel->getMemory() + m_lockTable->getMemory() + sketchMemory;
+}
+
+// 把采样得到的节点加入淘汰池：淘汰池按照空闲时间升序排列，已满时
+// 替换空闲时间最短的候选。逻辑时钟回绕后空闲时间按照无符号差值计算
+void SimpleCache::addCandidate(CacheEntry* entry) {
+    uint32_t idle = m_lruClock - entry->getAccessTime();
+    auto& pool = m_evictionPool;
+    if (pool.size() >= EVICTION_POOL_SIZE && idle <= pool.front().m_idle)
+        return;
+    for (auto& candidate : pool) {
+        if (candidate.m_entry == entry) return;
+    }
+    auto pos = pool.begin();
+    while (pos != pool.end() && pos->m_idle < idle) ++pos;
+    if (pool.size() >= EVICTION_POOL_SIZE) {
+        // 移除空闲时间最短的候选，插入位置前移一位
+        pool.erase(pool.begin());
+        --pos;
+    }
+    pool.insert(pos, EvictionCandidate{ idle, entry->getAccessTime(),
+        entry });
+}
+
+// 近似LRU：从哈希表中连续采样lruSamples个节点加入淘汰池，之后从淘汰池
+// 中取出空闲时间最长的候选，采样之后又被访问过的候选直接丢弃。淘汰池
+// 为空时重新采样，最多EVICTION_MAX_ROUNDS轮
+CacheEntry* SimpleCache::getSampledVictim(bool volatileOnly) {
+    CacheEntry* samples[EVICTION_MAX_SAMPLES];
+    int64 count = std::min(m_globalConfig->lruSamples, EVICTION_MAX_SAMPLES);
+    for (int64 round = 0; round < EVICTION_MAX_ROUNDS; round++) {
+        int64 size = m_cacheTable->sample(m_random(), samples, count);
+        if (size <= 0) return nullptr;
+        // 样本节点分散在堆上，先全部预取
+        for (int64 i = 0; i < size; i++) cachePrefetch(samples[i]);
+        for (int64 i = 0; i < size; i++) {
+            if (volatileOnly && samples[i]->getExpireTime() == 0) continue;
+            addCandidate(samples[i]);
+        }
+        while (!m_evictionPool.empty()) {
+            EvictionCandidate candidate = m_evictionPool.back();
+            m_evictionPool.pop_back();
+            auto entry = candidate.m_entry;
+            if (entry->getAccessTime() != candidate.m_accessTime) continue;
+            if (volatileOnly && entry->getExpireTime() == 0) continue;
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+// 按照淘汰策略选择被淘汰的节点，没有可以淘汰的节点时返回nullptr
+CacheEntry* SimpleCache::getVictim() {
+    if (m_approxLru && (m_policy == AllKeysLru || m_policy == VolatileLru))
+        return getSampledVictim(m_policy == VolatileLru);
+    switch (m_policy) {
+    case AllKeysLru:
+        return static_cast<CacheEntry*>(m_linkedList->getTail());
+    case AllKeysRandom:
+        return m_cacheTable->sample(m_random());
+    case TinyLfu:
+        return m_tinyLfu->getVictim(m_random());
+    case VolatileLru: {
+        // 从链表末尾开始查找设置了过期时间的节点，最多检查expireCount个
+        CacheEntry* victim = nullptr;
+        int64 count = 0, maxCount = m_globalConfig->expireCount;
+        NodeType* node = m_linkedList->getTail();
+        NodeType* head = m_linkedList->getHead();
+        while (node && node != head && count < maxCount) {
+            auto entry = static_cast<CacheEntry*>(node);
+            if (entry->getExpireTime() != 0) {
+                victim = entry; break;
+            }
+            node = node->getPrev();
+            count++;
+        }
+        return victim;
+    }
+    default:
+        return nullptr;
+    }
 }
 
-SimpleCache::NodeType* SimpleCache::getHead() {
-    return m_linkedList->getHead();
+// 淘汰entry以外的数据，直到key数量加上reserve不超过上限并且内存不超过
+// 上限。没有可以淘汰的节点或者只能淘汰entry时返回false
+bool SimpleCache::evictOthers(int64 reserve, CacheEntry* entry) {
+    int64 maxSize = m_maxSize;
+    int64 maxMemory = m_maxMemory;
+    while ((maxSize > 0 && getSize() + reserve > maxSize) ||
+        (maxMemory > 0 && getUsedMemory() > maxMemory)) {
+        auto victim = getSize() > 0 ? getVictim() : nullptr;
+        if (!victim || victim == entry) return false;
+        keepClientLock(victim);
+        del(victim);
+        m_evictedKeys++;
+    }
+    // 缓存未满，窗口溢出的节点不需要准入比较
+    if (m_tinyLfu) m_tinyLfu->shrinkWindow();
+    return true;
 }
 
-SimpleCache::NodeType* SimpleCache::getTail() {
-    return m_linkedList->getTail();
+bool SimpleCache::evict(CacheEntry* entry) {
+    // 新节点需要预留一个key的位置
+    if (evictOthers(entry ? 0 : 1, entry)) return true;
+    m_rejectedWrites++;
+    return false;
+}
+
+// 超出的部分只能淘汰刚写入的节点时保留，之后的写操作会被拒绝
+void SimpleCache::shrink(CacheEntry* entry) {
+    evictOthers(0, entry);
+}
+
+int64 SimpleCache::getSize() {
+    return m_cacheTable->getSize();
+}
+
+std::vector<SimpleCache::LinkedList*> SimpleCache::getLists() {
+    if (m_tinyLfu) return m_tinyLfu->getLists();
+    return { m_linkedList };
 }
 
 int64 SimpleCache::walk(std::function<void(const NodeType*)> func, 
     int64 maxSize) {
-    return m_linkedList->walk(func, maxSize, false);
+    int64 count = 0;
+    for (auto list : getLists()) {
+        count += list->walk(func, maxSize - count, false);
+    }
+    return count;
+}
+
+uint64_t SimpleCache::scan(uint64_t cursor, int64 count,
+    std::function<void(CacheEntry*)> func) {
+    return m_cacheTable->scan(cursor, count, func);
 }
 
-void SimpleCache::setClientLock(std::string& key, std::string& name) {
+void SimpleCache::setClientLock(CacheEntry* entry, SessionHandle session) {
     int64 time = getCurrentTime() + m_globalConfig->lockDuration;
-    auto pair = CachePair<std::string, ClientLock>{
-        key,
-        ClientLock {
-            name,
-            time,
-        }
-    };
-    m_clientLockTable->set(pair);
+    entry->setLock(session, time);
 }
 
-void SimpleCache::delClientLock(std::string& key) {
-    m_clientLockTable->del(key);
+void SimpleCache::delClientLock(CacheEntry* entry) {
+    entry->delLock();
 }
 
-// 如果锁不存在：返回false；如果锁过期：销毁锁，返回false；
+// 如果节点或者锁不存在：返回false；如果锁过期：销毁锁，返回false；
 // 如果锁未过期：判断客户端是否对应，是则返回false；否者返回true。
-bool SimpleCache::getClientLock(std::string& key, std::string& name) {
-    try {
-        auto& pair = m_clientLockTable->get(key);
-        if (getCurrentTime() >= pair.m_two.m_expireTime) {
-            delClientLock(key);
-            return false;
-        }
-        if (name == pair.m_two.m_name) {
-            return false;
-        }
-        return true;
+bool SimpleCache::getClientLock(CacheEntry* entry, SessionHandle session) {
+    if (!entry) return false;
+    auto lock = entry->getLock();
+    if (!lock) return false;
+    if (getCurrentTime() >= lock->m_expireTime) {
+        delClientLock(entry);
+        return false;
+    }
+    return session != lock->m_owner;
+}
+
+void SimpleCache::setClientLock(std::string_view key,
+    SessionHandle session) {
+    auto entry = find(key);
+    if (entry) {
+        setClientLock(entry, session);
+        return;
     }
-    catch (std::string e) {
+    int64 time = getCurrentTime() + m_globalConfig->lockDuration;
+    bool isNew = false;
+    auto pair = m_lockTable->emplace(key, isNew);
+    m_lockTable->update(pair, ClientLock{ session, time });
+}
+
+void SimpleCache::delClientLock(std::string_view key) {
+    auto entry = find(key);
+    if (entry) delClientLock(entry);
+    else m_lockTable->del(key);
+}
+
+bool SimpleCache::getClientLock(std::string_view key,
+    SessionHandle session) {
+    auto entry = find(key);
+    if (entry) return getClientLock(entry, session);
+    if (m_lockTable->getSize() == 0) return false;
+    auto pair = m_lockTable->find(key);
+    if (!pair) return false;
+    if (getCurrentTime() >= pair->m_two.m_expireTime) {
+        m_lockTable->del(key);
         return false;
     }
+    return session != pair->m_two.m_owner;
 }
 
-void SimpleCache::setExpire(std::string& key, int64 time) {
-    time += getCurrentTime();
-    auto pair = CachePair<std::string, int64>{
-        key,
-        time
-    };
-    m_expireTable->set(pair);
+// 被淘汰的节点上未过期的锁移入m_lockTable，淘汰不会解除客户端的锁
+void SimpleCache::keepClientLock(CacheEntry* entry) {
+    auto lock = entry->getLock();
+    if (!lock || getCurrentTime() >= lock->m_expireTime) return;
+    bool isNew = false;
+    auto pair = m_lockTable->emplace(entry->getKey(), isNew);
+    m_lockTable->update(pair, *lock);
 }
 
-void SimpleCache::delExpire(std::string& key) {
-    m_expireTable->del(key);
+// 回收m_lockTable中已经过期、之后没有再被访问的锁
+void SimpleCache::purgeClientLocks() {
+    int64 now = getCurrentTime();
+    std::vector<std::string> keys;
+    m_lockTable->walk([&keys, now](const LockTable::PairType& pair) {
+        if (now >= pair.m_two.m_expireTime) keys.push_back(pair.m_one);
+    });
+    for (auto& key : keys) m_lockTable->del(key);
+}
+
+void SimpleCache::setExpire(CacheEntry* entry, int64 time) {
+    m_timerWheel->schedule(entry, time + getCurrentTime());
+}
+
+void SimpleCache::delExpire(CacheEntry* entry) {
+    m_timerWheel->remove(entry);
 }
 
 // 如果未设置过期时间，则数据未过期；如果设置过期时间则检查是否超时；
-// 如果超时则销毁对应key(从链表移除，删除对象，删除客户端锁，删除过期时间)
-bool SimpleCache::getExpire(std::string& key) {
-    try {
-        auto& pair = m_expireTable->get(key);
-        if (getCurrentTime() >= pair.m_two) {
-            del(key); return true;
+// 如果超时则销毁对应节点(从链表移除，删除对象，客户端锁和过期时间随节点销毁)
+bool SimpleCache::getExpire(CacheEntry* entry) {
+    if (!entry || entry->getExpireTime() == 0) return false;
+    if (getCurrentTime() >= entry->getExpireTime()) {
+        del(entry);
+        m_expiredKeys++;
+        return true;
+    }
+    return false;
+}
+
+int64 SimpleCache::expire() {
+    auto deadline = CacheTimerWheel::Clock::now() +
+        std::chrono::microseconds(m_globalConfig->expireBudget);
+    int64 count = m_timerWheel->advance(getCurrentTime(), deadline,
+        [this](CacheEntry* entry) { del(entry); });
+    m_expiredKeys += count;
+    if (m_lockTable->getSize() > 0) purgeClientLocks();
+    return count;
+}
+
+std::string SimpleCache::getInfo() {
+    int64 keys = getSize();
+    int64 tableMemory = m_cacheTable->getMemory();
+    // 每个key的固定开销：槽位和控制字节，CacheEntry本身(其中包括值)
+    int64 overhead = keys > 0 ? (tableMemory +
+        keys * (int64)sizeof(CacheEntry)) / keys : 0;
+    std::string result;
+    result += "keys:" + std::to_string(keys) + "\r\n";
+    result += "table_capacity:" +
+        std::to_string(m_cacheTable->getCapacity()) + "\r\n";
+    result += "table_memory:" + std::to_string(tableMemory) + "\r\n";
+    result += "entry_memory:" + std::to_string(m_entryMemory) + "\r\n";
+    result += "entry_size:" + std::to_string(sizeof(CacheEntry)) + "\r\n";
+    result += "key_overhead:" + std::to_string(overhead) + "\r\n";
+    result += "value_memory:" + std::to_string(m_valueMemory) + "\r\n";
+    result += "used_memory:" + std::to_string(getUsedMemory()) + "\r\n";
+    result += "max_memory:" + std::to_string(m_maxMemory) + "\r\n";
+    result += "max_keys:" + std::to_string(m_maxSize) + "\r\n";
+    result += "eviction_policy:" + m_globalConfig->evictionPolicy + "\r\n";
+    result += "lru_mode:" + std::string(m_approxLru ? "approx" : "exact") +
+        "\r\n";
+    result += "evicted_keys:" + std::to_string(m_evictedKeys) + "\r\n";
+    result += "rejected_writes:" + std::to_string(m_rejectedWrites) +
+        "\r\n";
+    result += "expires:" + std::to_string(m_timerWheel->getSize()) + "\r\n";
+    result += "expired_keys:" + std::to_string(m_expiredKeys) + "\r\n";
+    if (m_tinyLfu) result += m_tinyLfu->getInfo();
+    return result;
+}
+
+
+// 写操作查找key对应的节点，不存在时创建新节点。只修改已有节点时不为
+// 新的key腾出位置，只在内存已经超过上限时淘汰其他数据。key被其他客户端
+// 加锁或者无法腾出空间时返回错误信息，成功时返回nullptr
+static const std::string* emplaceForWrite(SimpleCache* cache,
+    std::string_view key, SessionHandle session, CacheEntry*& entry,
+    bool& isNew) {
+    isNew = false;
+    entry = cache->find(key);
+    if (entry) {
+        if (cache->getClientLock(entry, session)) {
+            return &KEY_VALUE_IS_LOCKED;
         }
-        return false;
+        if (!cache->evict(entry)) {
+            return &OUT_OF_MEMORY;
+        }
+        cache->touch(entry);
+        return nullptr;
     }
-    catch (std::string e) {
-        return false;
+    if (cache->getClientLock(key, session)) {
+        return &KEY_VALUE_IS_LOCKED;
     }
+    if (!cache->evict()) {
+        return &OUT_OF_MEMORY;
+    }
+    entry = cache->emplace(key, isNew);
+    return nullptr;
 }
 
-
 std::string setKeyValueHandler(Request &rq) {
     // 检查指令格式，指令长度为3或5，至少为3
     if (rq.cmd.size() != 3 && rq.cmd.size() != 5) {
@@ -211,88 +593,260 @@ std::string setKeyValueHandler(Request &rq) {
         if (rq.cmd[3] != EXPIRE_COMMAND) {
             return WRONG_REQUEST_COMMAND;
         }
-        if (!isNumber(rq.cmd[4])) {
-            return WRONG_REQUEST_FORMAT;
-        }
-        expireTime = std::stoll(rq.cmd[4]);
-        if (expireTime <= 0) {
+        if (!toNumber(rq.cmd[4], expireTime) || expireTime <= 0) {
             return WRONG_REQUEST_FORMAT;
         }
     }
     auto cache = getSimpleCache();
-    std::string key = rq.cmd[1], value = rq.cmd[2];
-    auto type = isNumber(rq.cmd[2]) ? LongType : StringType;
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+    std::string_view key = rq.cmd[1];
+    std::string_view value = rq.cmd[2];
+    CacheEntry* entry = nullptr;
+    bool isNew = false;
+    if (auto error = emplaceForWrite(cache, key, rq.m_session, entry,
+        isNew)) {
+        return *error;
     }
-    auto object = getInstance<CacheValue>(type);
-    object->setValue(value);
+    CacheValue object;
+    object.setValue(value);
 
-    cache->set(key, object);
+    cache->set(entry, object);
 
     // 设置新过期时间
     if (expireTime > 0) {
-        cache->setExpire(rq.cmd[1], expireTime);
+        cache->setExpire(entry, expireTime);
     }
+    cache->shrink(entry);
     return "ok";
 }
 
-std::string getKeyValueHandler(Request &rq) {
-    if (rq.cmd.size() != 2) {
-        return WRONG_REQUEST_FORMAT;
-    }
-    std::string key = rq.cmd[1];
-    auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+// 返回整数的指令：文本协议为"ok <n>"，RESP2为整数":<n>\r\n"。直接在栈上
+// 格式化，结果不超过短字符串的长度时不需要分配内存
+static std::string formatInteger(const Request& rq, int64 value) {
+    char buffer[32] = "ok ";
+    size_t size = 3;
+    if (rq.m_protocol == RespProtocol) buffer[size++] = ':';
+    auto end = std::to_chars(buffer + size, buffer + sizeof(buffer) - 2,
+        value).ptr;
+    size = end - buffer;
+    if (rq.m_protocol == RespProtocol) {
+        buffer[size++] = '\r';
+        buffer[size++] = '\n';
+    }
+    return std::string(buffer, size);
+}
+
+// 游标为无符号64位整数
+static bool toCursor(std::string_view str, uint64_t& cursor) {
+    auto end = str.data() + str.size();
+    auto parsed = std::from_chars(str.data(), end, cursor);
+    return parsed.ec == std::errc() && parsed.ptr == end;
+}
+
+// cmd[index]之后可选的"count <n>"，n超过SCAN_MAX_COUNT时按照最大值处理
+static bool getScanCount(const Request& rq, size_t index, int64& count) {
+    count = SCAN_DEFAULT_COUNT;
+    if (rq.cmd.size() == index) return true;
+    if (rq.cmd.size() != index + 2 ||
+        !isCommand(rq.cmd[index], COUNT_COMMAND)) {
+        return false;
     }
-    if (cache->getExpire(key)) {
-        return KEY_VALUE_IS_EXPIRED;
+    if (!toNumber(rq.cmd[index + 1], count) || count <= 0) return false;
+    count = std::min(count, SCAN_MAX_COUNT);
+    return true;
+}
+
+// 返回多个元素：文本协议中每个元素为"<len>\r\n<data>\r\n"，RESP2为bulk
+// string数组
+static void appendItems(std::string& result, RequestProtocol protocol,
+    const std::vector<std::string>& items) {
+    if (protocol == RespProtocol) {
+        appendRespArray(result, items.size());
+        for (auto& item : items) appendRespBulk(result, item);
+        return;
     }
-    auto object = cache->get(key);
-    if (!object) {
-        return KEY_VALUE_NOT_EXIST;
+    for (auto& item : items) {
+        result += std::to_string(item.size());
+        result += "\r\n";
+        result += item;
+        result += "\r\n";
     }
+}
+
+// 文本协议为"ok <cursor> <n>\r\n"之后的n个元素，RESP2和redis的SCAN相同，
+// 为游标和元素数组组成的数组
+static std::string formatScan(const Request& rq, uint64_t cursor,
+    const std::vector<std::string>& items) {
     std::string result = "ok ";
-    switch (object->getType()) {
+    if (rq.m_protocol == RespProtocol) {
+        appendRespArray(result, 2);
+        appendRespBulk(result, std::to_string(cursor));
+    }
+    else {
+        result += std::to_string(cursor);
+        result += ' ';
+        result += std::to_string(items.size());
+        result += "\r\n";
+    }
+    appendItems(result, rq.m_protocol, items);
+    return result;
+}
+
+// 超过该长度的字符串值不拷贝到结果中，结果引用缓存中的值
+const size_t SHARED_VALUE_SIZE = 1024;
+
+// 返回值为"ok "，较长的字符串值的引用放在rq.m_value中
+static bool shareValue(Request& rq, const CacheValue& object) {
+    if (object.getStringSize() <= SHARED_VALUE_SIZE) return false;
+    rq.m_value = object.getString();
+    return true;
+}
+
+// get返回的值：字符串和整型数返回值本身，链表和字典返回类型信息
+static void appendObject(std::string& result, std::string_view key,
+    const CacheValue& object) {
+    switch (object.getType()) {
     case LongType:
-        result += 
-            dynamic_cast<CacheValue*>(object)->getValue();
+        result += object.getValue();
         break;
     case StringType:
-        result += 
-            dynamic_cast<CacheValue*>(object)->getValue();
+        result += object.getValue();
         break;
     case ListType:
-        result += key + " (list)";
+        result += key;
+        result += " (list)";
         break;
     case DictType:
-        result += key + " (dict)";
+        result += key;
+        result += " (dict)";
         break;
     }
+}
+
+std::string getKeyValueHandler(Request &rq) {
+    if (rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    std::string_view key = rq.cmd[1];
+    auto cache = getSimpleCache();
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
+        return KEY_VALUE_IS_LOCKED;
+    }
+    if (cache->getExpire(entry)) {
+        return KEY_VALUE_IS_EXPIRED;
+    }
+    if (!entry) {
+        return KEY_VALUE_NOT_EXIST;
+    }
+    cache->touch(entry);
+    std::string result = "ok ";
+    if (shareValue(rq, entry->getValue())) return result;
+    appendObject(result, key, entry->getValue());
     return result;
 }
 
+// 文本协议返回"ok <version> <value>"，RESP2返回value和version组成的数组
+std::string getsKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    std::string_view key = rq.cmd[1];
+    auto cache = getSimpleCache();
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
+        return KEY_VALUE_IS_LOCKED;
+    }
+    if (cache->getExpire(entry)) {
+        return KEY_VALUE_IS_EXPIRED;
+    }
+    if (!entry) {
+        return KEY_VALUE_NOT_EXIST;
+    }
+    cache->touch(entry);
+    std::string version = std::to_string(entry->getVersion());
+    std::string result = "ok ";
+    if (rq.m_protocol == RespProtocol) {
+        std::string value;
+        appendObject(value, key, entry->getValue());
+        appendRespArray(result, 2);
+        appendRespBulk(result, value);
+        result += ':';
+        result += version;
+        result += "\r\n";
+        return result;
+    }
+    result += version;
+    result += ' ';
+    appendObject(result, key, entry->getValue());
+    return result;
+}
+
+// 版本号和gets返回的版本号相同时才写入，成功时返回新的版本号。
+// 和set一样清除原有的过期时间，可以同时设置新的过期时间
+std::string casKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 4 && rq.cmd.size() != 6) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 version = 0;
+    if (!toNumber(rq.cmd[2], version)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 expireTime = 0;
+    if (rq.cmd.size() == 6) {
+        if (rq.cmd[4] != EXPIRE_COMMAND) {
+            return WRONG_REQUEST_COMMAND;
+        }
+        if (!toNumber(rq.cmd[5], expireTime) || expireTime <= 0) {
+            return WRONG_REQUEST_FORMAT;
+        }
+    }
+    std::string_view key = rq.cmd[1];
+    auto cache = getSimpleCache();
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
+        return KEY_VALUE_IS_LOCKED;
+    }
+    if (cache->getExpire(entry)) {
+        return KEY_VALUE_IS_EXPIRED;
+    }
+    if (!entry) {
+        return KEY_VALUE_NOT_EXIST;
+    }
+    if (entry->getVersion() != (uint64_t)version) {
+        return VERSION_MISMATCH;
+    }
+    cache->touch(entry);
+    CacheValue object;
+    object.setValue(rq.cmd[3]);
+    cache->set(entry, object);
+    if (expireTime > 0) {
+        cache->setExpire(entry, expireTime);
+    }
+    cache->shrink(entry);
+    return formatInteger(rq, (int64)entry->getVersion());
+}
+
 std::string expireKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 3) {
         return WRONG_REQUEST_FORMAT;
     }
-    if (!isNumber(rq.cmd[2])) {
+    int64 time = 0;
+    if (!toNumber(rq.cmd[2], time)) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string key = rq.cmd[1];
+    std::string_view key = rq.cmd[1];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-    if (cache->getExpire(key)) {
+    if (cache->getExpire(entry)) {
         return KEY_VALUE_IS_EXPIRED;
     }
-    if (!cache->has(key)) {
+    if (!entry) {
         return KEY_VALUE_NOT_EXIST;
     }
-    int64 time = std::stoll(rq.cmd[2]);
-    cache->setExpire(key, time);
+    cache->setExpire(entry, time);
     return "ok";
 }
 
@@ -300,187 +854,553 @@ std::string delKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 2) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string key = rq.cmd[1];
+    std::string_view key = rq.cmd[1];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-    if (!cache->has(key)) {
+    if (!entry) {
         return KEY_VALUE_NOT_EXIST;
     }
-    cache->del(key);
+    cache->del(entry);
     return "ok";
 }
 
+// 多key指令每次预取的key数量，预取的缓存行在使用之前不会被换出
+const int64 MULTI_PREFETCH_SIZE = 32;
+
+// 多key指令的参数个数不为stride的整数倍或者key过长时格式错误
+static bool checkMultiFormat(const Request& rq, size_t stride) {
+    size_t args = rq.cmd.size() - 1;
+    if (args == 0 || args % stride != 0) return false;
+    for (size_t i = 1; i < rq.cmd.size(); i += stride) {
+        if (rq.cmd[i].size() > CacheEntry::MAX_KEY_SIZE) return false;
+    }
+    return true;
+}
+
+// 按照MULTI_PREFETCH_SIZE个key一组预取，然后依次调用func(序号, 哈希值)
+template<class F>
+static void forEachKey(Request& rq, int64 stride, F func) {
+    auto cache = getSimpleCache();
+    int64 count = (int64)(rq.cmd.size() - 1) / stride;
+    for (int64 begin = 0; begin < count; begin += MULTI_PREFETCH_SIZE) {
+        int64 size = std::min(MULTI_PREFETCH_SIZE, count - begin);
+        auto hashes = cache->prefetch(&rq.cmd[1 + begin * stride], size,
+            stride);
+        for (int64 i = 0; i < size; i++) {
+            func(begin + i, hashes[i]);
+        }
+    }
+}
+
+// 不跨分片时直接生成结果；否则结果写入MultiRequest，最后完成的分片
+// 生成结果，其他分片返回空字符串
+template<class F>
+static std::string finishMulti(Request& rq, std::vector<MultiResult>& results,
+    F format) {
+    auto multi = rq.m_multi.get();
+    if (!multi) return format(rq, results);
+    auto& indexes = multi->m_indexes[currentShard];
+    for (size_t i = 0; i < indexes.size(); i++) {
+        multi->m_results[indexes[i]] = std::move(results[i]);
+    }
+    // acq_rel保证最后完成的分片可以看到其他分片写入的结果
+    if (multi->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return std::string();
+    }
+    return format(rq, multi->m_results);
+}
+
+// 文本协议："ok <n>\r\n"之后每个key一项"<len>\r\n<value>\r\n"，不存在时
+// 为"-1\r\n"；RESP2为bulk string数组，不存在时为nil
+static std::string formatMultiGet(const Request& rq,
+    const std::vector<MultiResult>& results) {
+    std::string result = "ok ";
+    if (rq.m_protocol == RespProtocol) {
+        appendRespArray(result, results.size());
+        for (auto& item : results) {
+            if (item.m_ok) appendRespBulk(result, item.m_value);
+            else result += RESP_NIL;
+        }
+        return result;
+    }
+    result += std::to_string(results.size());
+    result += "\r\n";
+    for (auto& item : results) {
+        if (!item.m_ok) {
+            result += "-1\r\n";
+            continue;
+        }
+        result += std::to_string(item.m_value.size());
+        result += "\r\n";
+        result += item.m_value;
+        result += "\r\n";
+    }
+    return result;
+}
+
+// 不存在、已过期、被其他客户端加锁以及不是字符串的key返回nil
+std::string multiGetKeyValueHandler(Request& rq) {
+    if (!checkMultiFormat(rq, 1)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    auto cache = getSimpleCache();
+    std::vector<MultiResult> results(rq.cmd.size() - 1);
+    forEachKey(rq, 1, [&](int64 i, uint64_t hash) {
+        auto entry = cache->find(rq.cmd[i + 1], hash);
+        if (!entry || cache->getClientLock(entry, rq.m_session) ||
+            cache->getExpire(entry)) {
+            return;
+        }
+        auto object = &entry->getValue();
+        if (object->getType() != StringType &&
+            object->getType() != LongType) {
+            return;
+        }
+        cache->touch(entry);
+        results[i].m_ok = true;
+        results[i].m_value = object->getValue();
+    });
+    return finishMulti(rq, results, formatMultiGet);
+}
+
+// 所有key都写入成功时返回ok，否则返回第一个失败的key的错误，其他key
+// 仍然写入，不保证原子性
+static std::string formatMultiSet(const std::vector<MultiResult>& results) {
+    for (auto& item : results) {
+        if (!item.m_ok) return item.m_value;
+    }
+    return "ok";
+}
+
+std::string multiSetKeyValueHandler(Request& rq) {
+    if (!checkMultiFormat(rq, 2)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    auto cache = getSimpleCache();
+    std::vector<MultiResult> results((rq.cmd.size() - 1) / 2);
+    forEachKey(rq, 2, [&](int64 i, uint64_t) {
+        CacheEntry* entry = nullptr;
+        bool isNew = false;
+        if (auto error = emplaceForWrite(cache, rq.cmd[i * 2 + 1],
+            rq.m_session, entry, isNew)) {
+            results[i].m_value = *error;
+            return;
+        }
+        CacheValue object;
+        object.setValue(rq.cmd[i * 2 + 2]);
+        cache->set(entry, object);
+        cache->shrink(entry);
+        results[i].m_ok = true;
+    });
+    return finishMulti(rq, results,
+        [](const Request&, const std::vector<MultiResult>& results) {
+            return formatMultiSet(results);
+        });
+}
+
+// 返回删除的key数量，RESP2为整数
+static std::string formatMultiDel(const Request& rq,
+    const std::vector<MultiResult>& results) {
+    int64 count = std::count_if(results.begin(), results.end(),
+        [](const MultiResult& item) { return item.m_ok; });
+    return formatInteger(rq, count);
+}
+
+// 不存在、已过期和被其他客户端加锁的key不删除
+std::string multiDelKeyValueHandler(Request& rq) {
+    if (!checkMultiFormat(rq, 1)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    auto cache = getSimpleCache();
+    std::vector<MultiResult> results(rq.cmd.size() - 1);
+    forEachKey(rq, 1, [&](int64 i, uint64_t hash) {
+        auto entry = cache->find(rq.cmd[i + 1], hash);
+        if (!entry || cache->getClientLock(entry, rq.m_session) ||
+            cache->getExpire(entry)) {
+            return;
+        }
+        cache->del(entry);
+        results[i].m_ok = true;
+    });
+    return finishMulti(rq, results, formatMultiDel);
+}
+
+// 整型数原地加上delta，不是整型数或者溢出时返回错误，成功时返回nullptr
+static const std::string* addNumber(CacheValue& value, int64 delta) {
+    if (value.getType() != LongType) {
+        return &VALUE_NOT_INTEGER;
+    }
+    int64 number = value.getLong();
+    if ((delta > 0 && number > LLONG_MAX - delta) ||
+        (delta < 0 && number < LLONG_MIN - delta)) {
+        return &INTEGER_OVERFLOW;
+    }
+    value.setLong(number + delta);
+    return nullptr;
+}
+
+// key不存在或者已经过期时从0开始，保留原有的过期时间
+static std::string incrementKeyValue(Request& rq, int64 delta) {
+    std::string_view key = rq.cmd[1];
+    auto cache = getSimpleCache();
+    auto entry = cache->find(key);
+    if (cache->getClientLock(entry, rq.m_session)) {
+        return KEY_VALUE_IS_LOCKED;
+    }
+    if (cache->getExpire(entry)) {
+        entry = nullptr;
+    }
+    if (entry) {
+        cache->touch(entry);
+    }
+    else {
+        if (cache->getClientLock(key, rq.m_session)) {
+            return KEY_VALUE_IS_LOCKED;
+        }
+        if (!cache->evict()) {
+            return OUT_OF_MEMORY;
+        }
+        bool isNew = false;
+        entry = cache->emplace(key, isNew);
+        entry->getValue().setLong(0);
+    }
+    auto& value = entry->getValue();
+    if (auto error = addNumber(value, delta)) {
+        return *error;
+    }
+    cache->updateVersion(entry);
+    return formatInteger(rq, value.getLong());
+}
+
+std::string incrKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    return incrementKeyValue(rq, 1);
+}
+
+std::string decrKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    return incrementKeyValue(rq, -1);
+}
+
+std::string incrByKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 3) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 delta = 0;
+    if (!toNumber(rq.cmd[2], delta)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    return incrementKeyValue(rq, delta);
+}
+
+std::string decrByKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 3) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 delta = 0;
+    if (!toNumber(rq.cmd[2], delta)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    // -LLONG_MIN溢出
+    if (delta == LLONG_MIN) {
+        return INTEGER_OVERFLOW;
+    }
+    return incrementKeyValue(rq, -delta);
+}
+
+// 每次访问本分片哈希表中count个分组对应的哈希值区间，返回其中未过期的
+// key。本分片遍历结束之后游标指向下一个分片的起点，所有分片遍历结束
+// 时返回0。遍历期间一直存在的key恰好返回一次
+std::string scanHandler(Request& rq) {
+    if (rq.cmd.size() < 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    uint64_t cursor = 0;
+    int64 count = 0;
+    if (!toCursor(rq.cmd[1], cursor) || !getScanCount(rq, 2, count)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 shards = (int64)getSimpleCaches().size();
+    uint64_t shard = cursor & SCAN_SHARD_MASK;
+    if (shard >= (uint64_t)shards) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    auto cache = getSimpleCache();
+    int64 now = getCurrentTime();
+    std::vector<std::string> keys;
+    uint64_t next = cache->scan(cursor & ~SCAN_SHARD_MASK, count,
+        [&keys, now](CacheEntry* entry) {
+        // 遍历期间不能修改哈希表，过期的key只跳过，不删除
+        int64 expireTime = entry->getExpireTime();
+        if (expireTime == 0 || now < expireTime) {
+            keys.emplace_back(entry->getKey());
+        }
+    });
+    if (next != 0) {
+        next |= shard;
+    }
+    else if (shard + 1 < (uint64_t)shards) {
+        next = shard + 1;
+    }
+    return formatScan(rq, next, keys);
+}
+
 std::string dictSetKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 4) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string mainKey = rq.cmd[1];
-    std::string viceKey = rq.cmd[2];
-    std::string value = rq.cmd[3];
-    CacheType type = isNumber(value) ? LongType : StringType;
+    std::string_view mainKey = rq.cmd[1];
+    std::string_view viceKey = rq.cmd[2];
+    std::string_view value = rq.cmd[3];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(mainKey, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+    CacheEntry* entry = nullptr;
+    bool isNew = false;
+    if (auto error = emplaceForWrite(cache, mainKey, rq.m_session, entry,
+        isNew)) {
+        return *error;
     }
-    auto object = cache->get(mainKey);
     // 对应词典不存在则创建词典，对应对象不是词典类型则返回
     // 不支持的操作
-    if (!object) {
-        object = getInstance<CacheBase>(DictType);
-        cache->set(mainKey, object);
-    }      
+    int64 before = cache->getMemory(entry);
+    if (isNew) {
+        entry->getValue().setObject(getInstance<CacheBase>(DictType));
+    }
+    auto object = &entry->getValue();
     if (object->getType() != DictType)
         return UNSUPPORTED_OPERATION;
     
-    auto dict = dynamic_cast<CacheDict<std::string, 
-        CacheValue*>*>(object);
+    auto dict = dynamic_cast<ValueDict*>(object->getObject());
 
-    auto temp = getInstance<CacheValue>(type);
-    temp->setValue(value);
-    try {
-        auto& pair = dict->get(viceKey);
-        delInstance(pair.m_two);
-        pair.m_two = temp;
+    CacheValue temp;
+    temp.setValue(value);
+    auto pair = dict->emplace(viceKey, isNew);
+    CacheValue old = pair->m_two;
+    dict->update(pair, temp);
+    delInstance(old);
+    cache->account(entry, before);
+    cache->shrink(entry);
+
+    return "ok";
+}
+
+// 字典中的字段不存在时从0开始
+std::string dictIncrByKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 4) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 delta = 0;
+    if (!toNumber(rq.cmd[3], delta)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    std::string_view mainKey = rq.cmd[1];
+    std::string_view viceKey = rq.cmd[2];
+    auto cache = getSimpleCache();
+    CacheEntry* entry = nullptr;
+    bool isNew = false;
+    if (auto error = emplaceForWrite(cache, mainKey, rq.m_session, entry,
+        isNew)) {
+        return *error;
     }
-    catch(std::string e){
-        auto pair = CachePair<std::string, CacheValue*>{
-            viceKey,
-            temp
-        };
-        dict->set(pair);
+    int64 before = cache->getMemory(entry);
+    if (isNew) {
+        entry->getValue().setObject(getInstance<CacheBase>(DictType));
     }
+    auto object = &entry->getValue();
+    if (object->getType() != DictType)
+        return UNSUPPORTED_OPERATION;
 
-    return "ok";
+    auto dict = dynamic_cast<ValueDict*>(object->getObject());
+
+    auto pair = dict->emplace(viceKey, isNew);
+    CacheValue temp = pair->m_two;
+    if (isNew) temp.setLong(0);
+    if (auto error = addNumber(temp, delta)) {
+        return *error;
+    }
+    dict->update(pair, temp);
+    cache->account(entry, before);
+    cache->shrink(entry);
+    return formatInteger(rq, temp.getLong());
+}
+
+// 字典的增量遍历，返回的元素为字段和值交替，key不存在时返回空的结果
+std::string dictScanKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() < 3) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    uint64_t cursor = 0;
+    int64 count = 0;
+    if (!toCursor(rq.cmd[2], cursor) || !getScanCount(rq, 3, count)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    std::string_view mainKey = rq.cmd[1];
+    auto cache = getSimpleCache();
+    auto entry = cache->find(mainKey);
+    if (cache->getClientLock(entry, rq.m_session)) {
+        return KEY_VALUE_IS_LOCKED;
+    }
+    std::vector<std::string> items;
+    if (cache->getExpire(entry) || !entry) {
+        return formatScan(rq, 0, items);
+    }
+    cache->touch(entry);
+    auto object = &entry->getValue();
+    if (object->getType() != DictType)
+        return UNSUPPORTED_OPERATION;
+
+    auto dict = dynamic_cast<ValueDict*>(object->getObject());
+    uint64_t next = dict->scan(cursor, count,
+        [&items](const ValueDict::PairType& pair) {
+        items.push_back(pair.m_one);
+        items.push_back(pair.m_two.getValue());
+    });
+    return formatScan(rq, next, items);
 }
 
 std::string dictGetKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 3) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string mainKey = rq.cmd[1];
-    std::string viceKey = rq.cmd[2];
+    std::string_view mainKey = rq.cmd[1];
+    std::string_view viceKey = rq.cmd[2];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(mainKey, rq.m_name)) {
+    auto entry = cache->find(mainKey);
+    if (cache->getClientLock(entry, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-    if (cache->getExpire(mainKey)) {
+    if (cache->getExpire(entry)) {
         return KEY_VALUE_IS_EXPIRED;
     }
-
-    auto object = cache->get(mainKey);
-    if (!object)
+    if (!entry)
         return KEY_VALUE_NOT_EXIST;
+    cache->touch(entry);
+    auto object = &entry->getValue();
     if (object->getType() != DictType)
         return UNSUPPORTED_OPERATION;
 
-    auto dict = dynamic_cast<CacheDict<std::string,
-        CacheValue*>*>(object);
+    auto dict = dynamic_cast<ValueDict*>(object->getObject());
 
-    std::string result = "ok ";
-    try {
-        auto& pair = dict->get(viceKey);
-        return result + pair.m_two->getValue();
-    }
-    catch (std::string e) {
+    auto pair = dict->find(viceKey);
+    if (!pair)
         return KEY_VALUE_NOT_EXIST;
-    }
+    if (shareValue(rq, pair->m_two)) return "ok ";
+    return "ok " + pair->m_two.getValue();
 }
 
 std::string dictDelKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 3) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string mainKey = rq.cmd[1];
-    std::string viceKey = rq.cmd[2];
+    std::string_view mainKey = rq.cmd[1];
+    std::string_view viceKey = rq.cmd[2];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(mainKey, rq.m_name)) {
+    auto entry = cache->find(mainKey);
+    if (cache->getClientLock(entry, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-
-    auto object = cache->get(mainKey);
-    if (!object)
+    if (!entry)
         return KEY_VALUE_NOT_EXIST;
-
+    cache->touch(entry);
+    auto object = &entry->getValue();
     if (object->getType() != DictType)
         return UNSUPPORTED_OPERATION;
 
-    auto dict = dynamic_cast<CacheDict<std::string,
-        CacheValue*>*>(object);
+    auto dict = dynamic_cast<ValueDict*>(object->getObject());
 
-    try {
-        auto& pair = dict->get(viceKey);
-        delInstance(pair.m_two);
-        dict->del(viceKey);
-        return "ok";
-    }
-    catch (std::string e) {
+    auto pair = dict->find(viceKey);
+    if (!pair)
         return KEY_VALUE_NOT_EXIST;
-    }
+    int64 before = cache->getMemory(entry);
+    CacheValue old = pair->m_two;
+    dict->del(viceKey);
+    delInstance(old);
+    cache->account(entry, before);
+    return "ok";
 }
 
 std::string listAddKeyValueHandler(Request &rq) {
     if (rq.cmd.size() < 3) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string key = rq.cmd[1];
+    std::string_view key = rq.cmd[1];
 
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+    CacheEntry* entry = nullptr;
+    bool isNew = false;
+    if (auto error = emplaceForWrite(cache, key, rq.m_session, entry,
+        isNew)) {
+        return *error;
     }
-
-    auto object = cache->get(key);
-
-    if (!object) {
-        object = getInstance<CacheBase>(ListType);
-        cache->set(key, object);
+    int64 before = cache->getMemory(entry);
+    if (isNew) {
+        entry->getValue().setObject(getInstance<CacheBase>(ListType));
     }
+    auto object = &entry->getValue();
     if (object->getType() != ListType)
         return UNSUPPORTED_OPERATION;
-    auto list = dynamic_cast<CacheList<CacheValue*>*>
-        (object);
+    auto list = dynamic_cast<ValueList*>(object->getObject());
 
     for (int64 i = 2; i < rq.cmd.size(); i++) {
-        std::string value = rq.cmd[i];
-        auto type = isNumber(value) ? LongType : StringType;
-        auto temp = getInstance<CacheValue>(type);
-        temp->setValue(value);
+        CacheValue temp;
+        temp.setValue(rq.cmd[i]);
         list->add(temp);
     }
+    cache->account(entry, before);
+    cache->shrink(entry);
     return "ok";
 }
 
-std::string listPopKeyValueHandler(Request &rq) {
-    if (rq.cmd.size() != 2) {
-        return WRONG_REQUEST_FORMAT;
-    }
-    std::string key = rq.cmd[1];
-
+// 查找链表类型的对象，查找失败时通过error返回错误信息
+ValueList* findList(Request& rq, std::string& error,
+    CacheEntry** found = nullptr) {
+    std::string_view key = rq.cmd[1];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+    auto entry = cache->find(key);
+    if (found) *found = entry;
+    if (cache->getClientLock(entry, rq.m_session)) {
+        error = KEY_VALUE_IS_LOCKED;
+        return nullptr;
     }
-    auto object = cache->get(key);
-    if (!object)
-        return KEY_VALUE_NOT_EXIST;
+    if (!entry) {
+        error = KEY_VALUE_NOT_EXIST;
+        return nullptr;
+    }
+    cache->touch(entry);
+    auto object = &entry->getValue();
     if (object->getType() != ListType) {
-        return UNSUPPORTED_OPERATION;
+        error = UNSUPPORTED_OPERATION;
+        return nullptr;
     }
+    return dynamic_cast<ValueList*>(object->getObject());
+}
 
-    auto list = dynamic_cast<CacheList<CacheValue*>*>
-        (object);
-
-    try {
-        auto temp = list->pop();
-        std::string result = "ok " + temp->getValue();
-        delInstance(temp);
-        return result;
+std::string listPopKeyValueHandler(Request &rq) {
+    if (rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
     }
-    catch(std::string e){
+    std::string error;
+    CacheEntry* entry = nullptr;
+    auto list = findList(rq, error, &entry);
+    if (!list)
+        return error;
+
+    if (list->getSize() <= 0) {
         return CONTAINER_IS_EMPTY;
     }
+    auto cache = getSimpleCache();
+    int64 before = cache->getMemory(entry);
+    auto temp = list->pop();
+    std::string result = "ok " + temp.getValue();
+    delInstance(temp);
+    cache->account(entry, before);
+    return result;
 }
 
 
@@ -488,71 +1408,98 @@ std::string listGetKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 2) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string key = rq.cmd[1];
-
-    auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
-    }
-    auto object = cache->get(key);
-    if (!object)
-        return KEY_VALUE_NOT_EXIST;
-    if (object->getType() != ListType) {
-        return UNSUPPORTED_OPERATION;
-    }
-
-    auto list = dynamic_cast<CacheList<CacheValue*>*>
-        (object);
+    std::string error;
+    auto list = findList(rq, error);
+    if (!list)
+        return error;
 
     if (list->getSize() <= 0) {
         return CONTAINER_IS_EMPTY;
     }
 
-    auto temp = list->getHead()->getNext()->getValue();
+    auto& temp = list->getHead()->getNext()->getValue();
 
-    return "ok " + temp->getValue();
+    return "ok " + temp.getValue();
 }
 
 std::string listAllKeyValueHandler(Request &rq) {
     if (rq.cmd.size() != 2) {
         return WRONG_REQUEST_FORMAT;
     }
-    std::string key = rq.cmd[1];
-
-    auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
-        return KEY_VALUE_IS_LOCKED;
+    std::string error;
+    auto list = findList(rq, error);
+    if (!list)
+        return error;
+   
+    auto node = list->getHead();
+    std::string result = "ok ";
+    // RESP2直接返回数组，元素可以包含\r\n
+    if (rq.m_protocol == RespProtocol) {
+        appendRespArray(result, list->getSize());
+        while ((node = node->getNext()) != nullptr) {
+            appendRespBulk(result, node->getValue().getValue());
+        }
+        return result;
     }
-
-    auto object = cache->get(key);
-    if (!object) 
-        return KEY_VALUE_NOT_EXIST;
-    if (object->getType() != ListType) {
-        return UNSUPPORTED_OPERATION;
+    while ((node = node->getNext()) != nullptr) {
+        result += node->getValue().getValue();
+        result += "\r\n";
     }
+    return result;
+}
 
-    auto list = dynamic_cast<CacheList<CacheValue*>*>
-        (object);
-   
-    auto node = list->getHead();
+// 和redis的LRANGE相同，下标从0开始，负数表示从尾部开始，包括stop。
+// 每次最多返回SCAN_MAX_COUNT个元素，从距离start较近的一端开始查找。
+// 文本协议为"ok <n>\r\n"之后的n个元素
+std::string listRangeKeyValueHandler(Request& rq) {
+    if (rq.cmd.size() != 4) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 start = 0;
+    int64 stop = 0;
+    if (!toNumber(rq.cmd[2], start) || !toNumber(rq.cmd[3], stop)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    std::vector<std::string> items;
+    std::string error;
+    auto list = findList(rq, error);
+    if (!list && error != KEY_VALUE_NOT_EXIST) {
+        return error;
+    }
+    int64 size = list ? list->getSize() : 0;
+    if (start < 0) start = std::max<int64>(0, start + size);
+    if (stop < 0) stop += size;
+    // start超出链表时直接返回空的一页，避免start + SCAN_MAX_COUNT溢出
+    if (start < size) {
+        stop = std::min({ stop, size - 1, start + SCAN_MAX_COUNT - 1 });
+    }
+    if (list && start < size && start <= stop) {
+        auto node = list->getNodeAt(start);
+        for (int64 i = start; i <= stop; i++) {
+            items.push_back(node->getValue().getValue());
+            node = node->getNext();
+        }
+    }
     std::string result = "ok ";
-    while (node = node->getNext()) {
-        result += node->getValue()->getValue();
+    if (rq.m_protocol != RespProtocol) {
+        result += std::to_string(items.size());
         result += "\r\n";
     }
+    appendItems(result, rq.m_protocol, items);
     return result;
 }
 
+// 锁和key存储在同一个节点中，不存在的key也可以加锁，key创建时锁移入节点
 std::string lockKeyValueHandler(Request& rq) {
     if (rq.cmd.size() != 2) {
         return WRONG_REQUEST_FORMAT;
     }
-    auto key = rq.cmd[1];
+    std::string_view key = rq.cmd[1];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
+    if (cache->getClientLock(key, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-    cache->setClientLock(key, rq.m_name);
+    cache->setClientLock(key, rq.m_session);
     return "ok";
 }
 
@@ -560,102 +1507,349 @@ std::string unlockKeyValueHandler(Request& rq) {
     if (rq.cmd.size() != 2) {
         return WRONG_REQUEST_FORMAT;
     }
-    auto key = rq.cmd[1];
+    std::string_view key = rq.cmd[1];
     auto cache = getSimpleCache();
-    if (cache->getClientLock(key, rq.m_name)) {
+    if (cache->getClientLock(key, rq.m_session)) {
         return KEY_VALUE_IS_LOCKED;
     }
-    cache->delClientLock(rq.cmd[1]);
+    cache->delClientLock(key);
     return "ok";
 }
 
+std::string pingHandler(Request& rq) {
+    if (rq.cmd.size() != 1) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    return "ok PONG";
+}
+
+std::string infoHandler(Request& rq) {
+    if (rq.cmd.size() != 1 && rq.cmd.size() != 2) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    int64 shards = (int64)getSimpleCaches().size();
+    int64 shard = 0;
+    if (rq.cmd.size() == 2 && (!toNumber(rq.cmd[1], shard) ||
+        shard < 0 || shard >= shards)) {
+        return WRONG_REQUEST_FORMAT;
+    }
+    auto buffer = getRequestBuffer(shard);
+    auto sessionManager = getSessionManager();
+    return "ok shard:" + std::to_string(shard) + "\r\nshards:" +
+        std::to_string(shards) + "\r\n" + getSimpleCache()->getInfo() +
+        "queue_size:" + std::to_string(buffer->getSize()) + "\r\n" +
+        "queue_capacity:" + std::to_string(buffer->getCapacity()) + "\r\n" +
+        "queue_full:" + std::to_string(buffer->getFullCount()) + "\r\n" +
+        "paused_sessions:" +
+        std::to_string(sessionManager->getPausedCount()) + "\r\n" +
+        "paused_total:" +
+        std::to_string(sessionManager->getPauseTotal()) + "\r\n";
+}
+
+std::vector<SimpleCache*>& getSimpleCaches() {
+    static std::vector<SimpleCache*> caches = []() {
+        int64 shards = std::max<int64>(1, getGlobalConfig()->shardCount);
+        std::vector<SimpleCache*> result;
+        for (int64 i = 0; i < shards; i++) {
+            result.push_back(new SimpleCache());
+        }
+        return result;
+    }();
+    return caches;
+}
+
 SimpleCache* getSimpleCache() {
-    static SimpleCache* cache = new SimpleCache();
-    return cache;
+    return getSimpleCaches()[currentShard];
+}
+
+SimpleCache* getSimpleCache(int64 shard) {
+    return getSimpleCaches()[shard];
 }
 
 void delSimpleCache() {
-    delete getSimpleCache();
+    for (auto cache : getSimpleCaches()) {
+        delete cache;
+    }
+    getSimpleCaches().clear();
 }
 
-void expireTaskHandler(){
-    auto cache = getSimpleCache();
+static int64 getKeyShard(std::string_view key, int64 shards) {
+    uint64_t hash = CacheHash<std::string_view>()(key);
+    return (int64)(hash % (uint64_t)shards);
+}
 
-    int64 count = 0, maxCount = getGlobalConfig()->expireCount;
+// info可以指定分片序号，scan的游标中包含分片序号，其他命令按照一级key
+// 选择分片，没有key的命令在第0个分片执行
+int64 getShardIndex(const Request& rq) {
+    int64 shards = (int64)getSimpleCaches().size();
+    if (shards == 1 || rq.cmd.size() < 2) return 0;
+    if (isCommand(rq.cmd[0], SCAN_COMMAND)) {
+        uint64_t cursor = 0;
+        if (!toCursor(rq.cmd[1], cursor)) return 0;
+        uint64_t shard = cursor & SCAN_SHARD_MASK;
+        return shard < (uint64_t)shards ? (int64)shard : 0;
+    }
+    if (isCommand(rq.cmd[0], INFO_COMMAND)) {
+        int64 shard = 0;
+        if (!toNumber(rq.cmd[1], shard) || shard < 0 || shard >= shards) {
+            return 0;
+        }
+        return shard;
+    }
+    return getKeyShard(rq.cmd[1], shards);
+}
 
-    auto tail = cache->getTail(), head = cache->getHead();
-    if (!tail) return;
+// 多key指令每个key占用的token数量，其他指令为0
+static size_t getMultiStride(std::string_view name) {
+    if (isCommand(name, MGET_COMMAND) || isCommand(name, MDEL_COMMAND)) {
+        return 1;
+    }
+    if (isCommand(name, MSET_COMMAND)) return 2;
+    return 0;
+}
 
-    auto temp = tail, prev = temp->getPrev();
-    
-    while (temp != head && count < maxCount) {
-        SimpleCache::PairType* pair_p =
-            getHeadPointer(temp, SimpleCache::PairType, m_two);
-        std::string key = pair_p->m_one;
-        // std::cout << key << std::endl;
-        // 锁过期自动销毁，第二个参数没有作用
-        cache->getClientLock(key, key);
-        // 数据过期自动销毁，包括链表关系，客户端锁，过期时间
-        cache->getExpire(key);
-        temp = prev; prev = temp->getPrev();
-        count++;
+// I/O线程不等待执行线程：队列已满时请求放入stalled，由连接稍后重新提交
+static void pushRequest(int64 shard, Request& rq,
+    std::vector<Request>& stalled, bool bulk) {
+    if (!getRequestBuffer(shard)->tryPush(rq, bulk)) {
+        stalled.push_back(std::move(rq));
     }
 }
 
+// 多key指令按照key所在的分片拆分为子请求，子请求保留指令名称和本分片
+// 的key(和value)，共享接收缓冲区。格式错误或者所有key在同一个分片时
+// 不拆分，返回false
+static bool dispatchMulti(Request& rq, size_t stride,
+    std::vector<Request>& stalled, bool bulk) {
+    int64 shards = (int64)getSimpleCaches().size();
+    if (shards == 1 || !checkMultiFormat(rq, stride)) return false;
+    size_t count = (rq.cmd.size() - 1) / stride;
+    auto multi = std::make_shared<MultiRequest>();
+    multi->m_indexes.resize(shards);
+    for (size_t i = 0; i < count; i++) {
+        int64 shard = getKeyShard(rq.cmd[1 + i * stride], shards);
+        multi->m_indexes[shard].push_back((uint32_t)i);
+    }
+    int64 pending = std::count_if(multi->m_indexes.begin(),
+        multi->m_indexes.end(), [](auto& x) { return !x.empty(); });
+    if (pending == 1) return false;
+    multi->m_pending.store(pending, std::memory_order_relaxed);
+    multi->m_results.resize(count);
+    for (int64 shard = 0; shard < shards; shard++) {
+        auto& indexes = multi->m_indexes[shard];
+        if (indexes.empty()) continue;
+        Request sub;
+        sub.m_session = rq.m_session;
+        sub.m_sequence = rq.m_sequence;
+        sub.m_protocol = rq.m_protocol;
+        sub.m_data = rq.m_data;
+        sub.m_multi = multi;
+        sub.cmd.reserve(1 + indexes.size() * stride);
+        sub.cmd.push_back(rq.cmd[0]);
+        for (auto index : indexes) {
+            auto token = rq.cmd.begin() + 1 + index * stride;
+            sub.cmd.insert(sub.cmd.end(), token, token + stride);
+        }
+        pushRequest(shard, sub, stalled, bulk);
+    }
+    return true;
+}
 
+void dispatchRequest(Request& rq, std::vector<Request>& stalled,
+    bool bulk) {
+    size_t stride = getMultiStride(rq.cmd[0]);
+    // 重新提交的子请求已经拆分过，按照第一个key所在的分片加入队列
+    if (stride > 0 && !rq.m_multi &&
+        dispatchMulti(rq, stride, stalled, bulk)) {
+        return;
+    }
+    pushRequest(getShardIndex(rq), rq, stalled, bulk);
+}
 
-void startServer() {
-    std::map<std::string, std::string(*)(Request &)> funcs = {
+// 过期的客户端锁在访问时回收，过期的key由时间轮回收
+void expireTaskHandler(){
+    getSimpleCache()->expire();
+}
+
+// 不区分大小写的透明比较，指令名称可以直接使用string_view查找
+struct CommandLess {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const {
+        return std::lexicographical_compare(a.begin(), a.end(),
+            b.begin(), b.end(), [](char x, char y) {
+            return std::tolower((unsigned char)x) <
+                std::tolower((unsigned char)y);
+        });
+    }
+};
+
+using RequestHandlerFunc = std::string(*)(Request &);
+using HandlerMap = std::map<std::string, RequestHandlerFunc, CommandLess>;
+
+static const HandlerMap& getHandlers() {
+    static const HandlerMap funcs = {
         {SET_COMMAND, setKeyValueHandler},        
         {GET_COMMAND, getKeyValueHandler},
         {EXPIRE_COMMAND, expireKeyValueHandler},  
         {DEL_COMMAND, delKeyValueHandler},
+        {GETS_COMMAND, getsKeyValueHandler},
+        {CAS_COMMAND, casKeyValueHandler},
+        {SCAN_COMMAND, scanHandler},
+
+        {MGET_COMMAND, multiGetKeyValueHandler},
+        {MSET_COMMAND, multiSetKeyValueHandler},
+        {MDEL_COMMAND, multiDelKeyValueHandler},
+
+        {INCR_COMMAND, incrKeyValueHandler},
+        {DECR_COMMAND, decrKeyValueHandler},
+        {INCRBY_COMMAND, incrByKeyValueHandler},
+        {DECRBY_COMMAND, decrByKeyValueHandler},
 
         {DSET_COMMAND, dictSetKeyValueHandler},   
         {DGET_COMMAND, dictGetKeyValueHandler},
         {DDEL_COMMAND, dictDelKeyValueHandler},
+        {DINCRBY_COMMAND, dictIncrByKeyValueHandler},
+        {DSCAN_COMMAND, dictScanKeyValueHandler},
 
         {LADD_COMMAND, listAddKeyValueHandler},
         {LPOP_COMMAND, listPopKeyValueHandler},   
         {LGET_COMMAND, listGetKeyValueHandler},   
         {LALL_COMMAND, listAllKeyValueHandler},  
+        {LRANGE_COMMAND, listRangeKeyValueHandler},
 
         {LOCK_COMMAND, lockKeyValueHandler},      
-        {UNLOCK_COMMAND, unlockKeyValueHandler}};
+        {UNLOCK_COMMAND, unlockKeyValueHandler},
 
-    auto buffer = getRequestBuffer();
-    auto cache = getSimpleCache();
+        {INFO_COMMAND, infoHandler},
+        {PING_COMMAND, pingHandler}};
+    return funcs;
+}
+
+// 文本协议的结果转换为RESP2编码：ok为+OK，ok <value>为bulk string，
+// 读取单个值的指令在对象不存在时返回nil，其他错误为-ERR <message>
+static std::string toRespReply(RequestHandlerFunc handler,
+    const std::string& result) {
+    const size_t OK_SIZE = 3; // "ok "
+    const size_t ERROR_SIZE = 6; // "error "
+    if (result.compare(0, ERROR_SIZE, "error ") == 0) {
+        bool readValue = handler == getKeyValueHandler ||
+            handler == getsKeyValueHandler ||
+            handler == dictGetKeyValueHandler ||
+            handler == listPopKeyValueHandler ||
+            handler == listGetKeyValueHandler;
+        if (readValue && (result == KEY_VALUE_NOT_EXIST ||
+            result == KEY_VALUE_IS_EXPIRED || result == CONTAINER_IS_EMPTY)) {
+            return RESP_NIL;
+        }
+        return respError(std::string_view(result).substr(ERROR_SIZE));
+    }
+    if (result.size() < OK_SIZE) {
+        return RESP_OK;
+    }
+    std::string_view value = std::string_view(result).substr(OK_SIZE);
+    // 这些指令在RESP2模式下直接生成RESP2编码的结果
+    if (handler == listAllKeyValueHandler ||
+        handler == multiGetKeyValueHandler ||
+        handler == multiDelKeyValueHandler ||
+        handler == getsKeyValueHandler || handler == casKeyValueHandler ||
+        handler == scanHandler || handler == dictScanKeyValueHandler ||
+        handler == listRangeKeyValueHandler ||
+        handler == incrKeyValueHandler || handler == decrKeyValueHandler ||
+        handler == incrByKeyValueHandler || handler == decrByKeyValueHandler ||
+        handler == dictIncrByKeyValueHandler) {
+        return std::string(value);
+    }
+    if (handler == pingHandler) {
+        return respStatus(value);
+    }
+    return respBulk(value);
+}
+
+// 执行线程每次从RequestBuffer中最多取出的请求数量
+const int64 REQUEST_BATCH_SIZE = 64;
+
+Reply handleRequest(Request& rq) {
+    auto& funcs = getHandlers();
+    auto it = funcs.find(rq.cmd[0]);
+    RequestHandlerFunc handler = nullptr;
+    std::string result;
+    if (it == funcs.end()) {
+        result = WRONG_REQUEST_COMMAND;
+    }
+    // key长度受CacheEntry限制
+    else if (rq.cmd.size() > 1 &&
+        rq.cmd[1].size() > CacheEntry::MAX_KEY_SIZE) {
+        result = WRONG_REQUEST_FORMAT;
+    }
+    else {
+        handler = it->second;
+        result = handler(rq);
+    }
+    if (rq.m_value) {
+        // 结果为"ok "，值由连接直接从缓存中写回
+        if (rq.m_protocol == RespProtocol) {
+            result = "$" + std::to_string(rq.m_value.size()) + "\r\n";
+        }
+        return Reply(std::move(result), std::move(rq.m_value));
+    }
+    if (rq.m_protocol == RespProtocol && !result.empty()) {
+        result = toRespReply(handler, result);
+    }
+    return result;
+}
+
+// 每个分片一个执行线程，只访问本分片的SimpleCache和RequestBuffer
+static void runShard(int64 shard) {
+    currentShard = shard;
+    auto buffer = getRequestBuffer(shard);
     auto session = getSessionManager();
 
-    std::cout << "Server task is started." << std::endl;
+    std::vector<Request> requests;
     while (true) {
-        Request rq = buffer->getRequest();
-        if (rq.m_name == EXPIRE_TASK) {
-            expireTaskHandler();
-            continue;
-        }
-        if (funcs.find(rq.cmd[0]) == funcs.end()) {
-            session->async_send(rq.m_name, 
-                WRONG_REQUEST_COMMAND);
-            continue;
+        int64 count = buffer->getRequests(requests, REQUEST_BATCH_SIZE);
+        for (int64 i = 0; i < count; i++) {
+            Request& rq = requests[i];
+            if (rq.m_session == EXPIRE_TASK) {
+                expireTaskHandler();
+                continue;
+            }
+            Reply result = handleRequest(rq);
+            // 尽早释放接收缓冲区，连接可以继续使用同一个缓冲区
+            rq.cmd.clear();
+            rq.m_data.reset();
+            rq.m_multi.reset();
+            if (result.empty()) continue;
+            session->async_send(rq, std::move(result));
         }
-        std::string (*func)(Request &) = funcs[rq.cmd[0]];
-        auto cache = getSimpleCache();
-        auto result = func(rq);
-        session->async_send(rq.m_name, result);
+    }
+}
+
+void startServer() {
+    // 在启动执行线程之前创建所有分片
+    int64 shards = (int64)getSimpleCaches().size();
+    std::vector<std::thread> executors;
+    for (int64 i = 0; i < shards; i++) {
+        executors.emplace_back(runShard, i);
+    }
+    std::cout << "Server task is started with " + std::to_string(shards) +
+        " shards." << std::endl;
+    for (auto& executor : executors) {
+        executor.join();
     }
     std::cout << "Server task is closed." << std::endl;
 }
 
 void startExpire() {
-    auto buffer = getRequestBuffer();
     auto config = getGlobalConfig();
+    int64 shards = (int64)getSimpleCaches().size();
     std::cout << "Expire task is started." << std::endl;
     while (true) {
         std::this_thread::sleep_for(
             std::chrono::milliseconds(config->expireCycle));
-        Request rq = Request(); rq.m_name = EXPIRE_TASK;
-        buffer->addRequest(rq);
+        for (int64 i = 0; i < shards; i++) {
+            Request rq = Request(); rq.m_session = EXPIRE_TASK;
+            getRequestBuffer(i)->addRequest(rq);
+        }
     }
     std::cout << "Expire task is closed." << std::endl;
 }
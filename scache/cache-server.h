@@ -3,59 +3,189 @@
 #include "cache-dict.h"
 #include "cache-list.h"
 #include "cache-base.h"
+#include "cache-entry.h"
+#include "cache-tinylfu.h"
+#include "cache-timer.h"
+#include "request-buffer.h"
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <vector>
+
+enum EvictionPolicy {
+    AllKeysLru, VolatileLru, AllKeysRandom, NoEviction, TinyLfu
+};
+
+// 近似LRU的淘汰候选：节点和采样时的访问时间，按照空闲时间升序排列。
+// 节点被删除时对应候选同时从淘汰池中移除
+struct EvictionCandidate {
+    uint32_t m_idle;
+    uint32_t m_accessTime;
+    CacheEntry* m_entry;
+};
+
+// 多key指令中一个key的执行结果：mget为值(不存在时m_ok为false)，mset
+// 失败时为错误信息，mdel为是否删除
+struct MultiResult {
+    bool m_ok = false;
+    std::string m_value;
+};
+
+// 跨分片的多key指令：I/O线程按照key所在的分片拆分为多个子请求，
+// m_indexes[shard]为该分片的key在原指令中的序号。每个分片把结果写入
+// m_results的对应位置，最后完成的分片生成结果并发送
+struct MultiRequest {
+    std::atomic<int64> m_pending{ 0 };
+    std::vector<MultiResult> m_results;
+    std::vector<std::vector<uint32_t>> m_indexes;
+};
 
 class SimpleCache {
 public:
-    using ClientLock = struct {
-        std::string m_name;
-        int64 m_expireTime;
-    };
-    using CacheTable = CacheDict<std::string, CacheListNode<CacheBase*>>;
-    using ExpireTable = CacheDict<std::string, int64>;
-    using ClientLockTable = CacheDict<std::string, ClientLock>;
-    using LinkedList = CacheList<CacheBase*>;
-    using PairType = CachePair<std::string, CacheListNode<CacheBase*>>;
-    using NodeType = CacheListNode<CacheBase*>;
+    using CacheTable = CacheHashTable<CacheEntry, CacheEntryKey,
+        CacheHash<std::string_view>>;
+    using LinkedList = CacheList<CacheValue>;
+    using NodeType = CacheListNode<CacheValue>;
+    using LockTable = CacheDict<std::string, ClientLock>;
 
 private:
-    ExpireTable* m_expireTable;
-    ClientLockTable* m_clientLockTable;
     LinkedList* m_linkedList;
     CacheTable* m_cacheTable;
     GlobalConfig* m_globalConfig;
 
+    // 本分片的key数量上限和内存上限，为全局配置的1/shardCount
+    int64 m_maxSize = 0;
+    int64 m_maxMemory = 0;
+
+    // 所有CacheEntry占用的内存(不包括值)
+    int64 m_entryMemory = 0;
+    // 所有值在CacheEntry之外占用的堆上内存，包括链表和字典中的数据
+    int64 m_valueMemory = 0;
+
+    EvictionPolicy m_policy = AllKeysLru;
+    int64 m_evictedKeys = 0;
+    int64 m_rejectedWrites = 0;
+    int64 m_expiredKeys = 0;
+    // 最近一次分配的版本号，删除后重新创建的key也不会得到旧的版本号
+    uint64_t m_version = 0;
+    std::mt19937_64 m_random;
+
+    // 近似LRU：touch只更新节点的逻辑访问时间，不移动链表节点，链表只
+    // 保持插入顺序。淘汰时随机采样，空闲时间最长的候选保存在淘汰池中
+    bool m_approxLru = false;
+    uint32_t m_lruClock = 0;
+    std::vector<EvictionCandidate> m_evictionPool;
+
+    // tinylfu策略：节点由CacheTinyLfu的三个链表管理，不使用m_linkedList
+    CacheTinyLfu* m_tinyLfu = nullptr;
+
+    // 设置了过期时间的key
+    CacheTimerWheel* m_timerWheel;
+
+    // 不存在的key上的客户端锁：key被创建时移入CacheEntry，key被淘汰时
+    // 未过期的锁移回这里，因此可以先对不存在的key加锁再写入
+    LockTable* m_lockTable;
+
+    CacheEntry* getVictim();
+    bool evictOthers(int64 reserve, CacheEntry* entry);
+    void keepClientLock(CacheEntry* entry);
+    void purgeClientLocks();
+    CacheEntry* getSampledVictim(bool volatileOnly);
+    void addCandidate(CacheEntry* entry);
+
+    // prefetch返回的哈希值
+    std::vector<uint64_t> m_batchHashes;
+
     std::mutex m_simpleCacheLock;
 
     SimpleCache();
     virtual ~SimpleCache();
 
 public:
-    void set(std::string &key, CacheBase* value);
-    CacheBase* get(std::string &key);
-    void del(std::string &key);
-    bool has(std::string &key);
+    // 查找key对应的节点，不改变LRU顺序，不存在时返回nullptr
+    CacheEntry* find(std::string_view key);
+    // 使用prefetch返回的哈希值查找
+    CacheEntry* find(std::string_view key, uint64_t hash);
+    // 批量查找之前计算keys[0], keys[stride], ...共count个key的哈希值，并
+    // 预取它们所在的分组和节点。返回的哈希值在下一次调用prefetch之前有效
+    const uint64_t* prefetch(const std::string_view* keys, int64 count,
+        int64 stride = 1);
+    // 查找key对应的节点，不存在时创建值为空字符串的新节点，通过isNew返回
+    // 是否为新节点。节点移动到链表首部
+    CacheEntry* emplace(std::string_view key, bool& isNew);
+
+    // 更新或者插入对象，返回实际存储的对象
+    CacheValue* set(std::string_view key, const CacheValue& value);
+    void set(CacheEntry* entry, const CacheValue& value);
+    CacheValue* get(std::string_view key);
+    void del(std::string_view key);
+    void del(CacheEntry* entry);
+    bool has(std::string_view key);
+    // 记录访问：exact模式节点移动到链表首部，approx模式只更新访问时间
+    void touch(CacheEntry* entry);
+
+    // 值被修改之后分配新的版本号，set和account会自动调用
+    void updateVersion(CacheEntry* entry);
+
+    // 直接修改节点中的链表或者字典前使用getMemory记录节点内存，修改后
+    // 使用account更新内存统计
+    int64 getMemory(CacheEntry* entry);
+    void account(CacheEntry* entry, int64 before);
+    int64 getUsedMemory();
+    // 写操作之前调用：创建新节点时entry为nullptr，key数量达到上限或者内存
+    // 超过上限时按照淘汰策略淘汰数据；修改已有节点时只在内存超过上限时淘汰
+    // entry以外的数据。无法腾出空间时返回false，写操作应当被拒绝
+    bool evict(CacheEntry* entry = nullptr);
+    // 写操作成功之后调用：内存超过上限时淘汰entry以外的数据
+    void shrink(CacheEntry* entry);
 
     int64 getSize();
-    NodeType* getHead();
-    NodeType* getTail();
-    
+    // 管理节点的所有链表，每个链表尾部为最久未访问的节点
+    std::vector<LinkedList*> getLists();
+
     int64 walk(std::function<void(const NodeType*)> func,
         int64 maxSize = LLONG_MAX);
+    // 增量遍历所有key，参考CacheHashTable::scan，返回下一次调用的游标
+    uint64_t scan(uint64_t cursor, int64 count,
+        std::function<void(CacheEntry*)> func);
 
-    void setClientLock(std::string& key, std::string& name);
-    void delClientLock(std::string& key);
-    bool getClientLock(std::string& key, std::string& name);
+    void setClientLock(CacheEntry* entry, SessionHandle session);
+    void delClientLock(CacheEntry* entry);
+    bool getClientLock(CacheEntry* entry, SessionHandle session);
+    // 按照key加锁、解锁和检查，key不存在时使用m_lockTable
+    void setClientLock(std::string_view key, SessionHandle session);
+    void delClientLock(std::string_view key);
+    bool getClientLock(std::string_view key, SessionHandle session);
 
-    void setExpire(std::string& key, int64 time);
-    void delExpire(std::string& key);
-    bool getExpire(std::string& key);
+    void setExpire(CacheEntry* entry, int64 time);
+    void delExpire(CacheEntry* entry);
+    bool getExpire(CacheEntry* entry);
+    // 回收已经过期的key，最多使用expireBudget微秒，返回回收的数量
+    int64 expire();
 
-    friend SimpleCache* getSimpleCache();
+    // 内存使用情况，以name:value的形式每行一项
+    std::string getInfo();
+
+    friend std::vector<SimpleCache*>& getSimpleCaches();
     friend void delSimpleCache();
 };
 
+// 所有分片的SimpleCache，第一次调用时按照shardCount创建
+std::vector<SimpleCache*>& getSimpleCaches();
+// 当前执行线程所在分片的SimpleCache，不在执行线程中时为第0个分片
 SimpleCache* getSimpleCache();
+SimpleCache* getSimpleCache(int64 shard);
 void delSimpleCache();
 
+// 根据一级key计算请求所在的分片，并添加到对应分片的RequestBuffer
+int64 getShardIndex(const Request& rq);
+// 多key指令按照key拆分到各个分片。不会阻塞：分片的队列已满时请求(或者
+// 没有加入队列的子请求)移动到stalled，由调用者按顺序重新提交。bulk请求
+// 不能占用队列最后1/4的空间
+void dispatchRequest(Request& rq, std::vector<Request>& stalled, bool bulk);
+// 在当前分片执行请求并返回编码后的结果。结果为空时没有结果需要发送：
+// 跨分片的多key指令由最后完成的分片发送结果
+Reply handleRequest(Request& rq);
+
 void startServer();
-void startExpire();
\ No newline at end of file
+void startExpire();
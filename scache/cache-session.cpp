@@ -1,175 +1,847 @@
 #include "cache-session.h"
 #include "request-buffer.h"
+#include "cache-server.h"
 #include "cache-tool.h"
 #include <boost/bind.hpp>
-#include <regex>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 
 namespace bpt = boost::posix_time;
 
-void revcHandlerImpl(std::string &peer, std::string &rawData) {
-    auto requestBuffer = getRequestBuffer();
-    static std::regex re("(\\S+)|(\"[^\"]*\")");
-    Request rq;
-    rq.m_name = peer;
-    std::sregex_iterator it(rawData.begin(), rawData.end(), re);
-    std::sregex_iterator endIt;
-    for (; it != endIt; ++it) {
-        rq.cmd.push_back(std::move(it->str()));
-    }
-    if (rq.cmd.size() == 0) {
-        rq.cmd.push_back(std::move(rawData));
-    }
-    requestBuffer->addRequest(rq);
+// 一个连接每轮最多提交的指令数量，剩余的指令排到io_service的队尾，
+// 流水线很深的连接不会推迟其他连接的读写
+const int64 DISPATCH_QUOTA = 128;
+// 正在处理的指令达到该数量的连接只能使用分片队列3/4的空间，逐条发送或者
+// 流水线较浅的连接在其他连接占满队列时仍然可以提交指令
+const size_t BULK_PIPELINE = 16;
+// 暂停的连接重试的间隔
+const int64 RESUME_INTERVAL = 1000; // us
+// 超过该长度的结果不拷贝到发送缓冲区，直接作为writev的一个缓冲区
+const size_t MAX_INLINE_REPLY = 1024;
+// 文本协议长度前缀的最大长度
+const size_t MAX_HEADER_SIZE = 21;
+// 缓冲区池的级数，以及每一级空闲缓冲区的总大小上限
+const size_t POOL_CLASS_COUNT = 8;
+const size_t POOL_CLASS_MEMORY = 4 << 20; // byte
+
+// 缓冲区只剩当前的引用。执行线程通过Request中的string_view读取缓冲区，
+// 读完之后释放引用(release)；use_count只是relaxed读取，需要acquire屏障
+// 才能保证这些读取发生在之后的覆盖写入或者放回池中之前
+static bool isUnique(const RequestData& buffer) {
+    if (buffer.use_count() != 1) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
 }
 
-void shutHandlerImpl(std::string &peer, std::string &message) {
-    std::string tempPeer = std::move(peer);
-    std::string tempMessage = std::move(message);
+void revcHandlerImpl(Request &rq, std::vector<Request>& stalled,
+    bool bulk) {
+    dispatchRequest(rq, stalled, bulk);
+}
+
+void pauseHandlerImpl(Session &session) {
+    getSessionManager()->pauseSession(session.getHandle());
+}
+
+void shutHandlerImpl(Session &session, std::string &message) {
     auto sessionManager = getSessionManager();
-    sessionManager->shutSession(peer);
-    std::cout << "Session: " + tempPeer + " is shutdowned: " + tempMessage
-              << std::endl;
+    sessionManager->shutSession(session.getHandle());
+    std::cout << "Session: " + session.getPeer() + " is shutdowned: " +
+        message << std::endl;
 }
 
-Session::Session(TcpSocket sock)
-    : m_tcpSocket(std::move(sock)), m_deadTimer(m_tcpSocket.get_io_service()) {
+Session::Session(StreamSocket sock, std::string name,
+    RequestProtocol protocol, BufferPool* bufferPool, IdleWheel* idleWheel)
+    : m_socket(std::move(sock)), m_bufferPool(bufferPool),
+    m_protocol(protocol), m_name(std::move(name)), m_idleWheel(idleWheel) {
     m_globalConfig = getGlobalConfig();
-    m_buffer = std::move(std::string(m_globalConfig->sessionBufferSize, '0'));
-    auto remoteEndpoint = m_tcpSocket.remote_endpoint();
-    m_name = remoteEndpoint.address().to_string() + ":" +
-             std::to_string(remoteEndpoint.port());
+    m_respParser.setMaxBulk((size_t)m_globalConfig->maxRequestSize);
+    // 流水线的结果可能分多次写回，关闭Nagle算法避免等待客户端的延迟ACK。
+    // unix domain socket没有该选项，忽略错误
+    boost::system::error_code ec;
+    m_socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+    // 只影响同步的read_some：可读之后读取已经到达的数据，不会阻塞
+    m_socket.non_blocking(true, ec);
 
-    m_lastAccess = getCurrentTime();
+    m_idleNode.m_session = this;
+    m_lastAccess = m_idleWheel->getNow();
+}
 
-    setDeadTimer(m_globalConfig->sessionDuration);
+void Session::start() {
+    checkIdle();
+    async_recv();
 }
 
-void Session::setDeadTimer(int64 time) {
-    m_deadTimer.expires_from_now(bpt::millisec(time));
-    m_deadTimer.async_wait([this](const boost::system::error_code &ec) {
-        if (ec) {
-            std::cout << "Dead Timer is cancelled." << std::endl;
-            return;
-        }
-        auto now = getCurrentTime();
-        auto interval = now - m_lastAccess;
-        if (interval >= m_globalConfig->sessionDuration) {
-            std::string messages = "Session expired.";
-            m_shutHandler(m_name, messages);
-        } else {
-            setDeadTimer(m_globalConfig->sessionDuration - interval);
-        }
-    });
+void Session::checkIdle() {
+    if (m_closed) return;
+    // 缓存的时钟最多落后一个槽位，多等待一个槽位，空闲时间不会少于
+    // sessionDuration
+    int64 deadline = m_lastAccess + m_globalConfig->sessionDuration +
+        m_idleWheel->getTickSize();
+    if (m_idleWheel->getNow() >= deadline) {
+        shutdown("Session expired.");
+    } else {
+        m_idleWheel->schedule(&m_idleNode, deadline);
+    }
 }
 
 Session::~Session() {
-    m_tcpSocket.shutdown(m_tcpSocket.shutdown_both);
-    m_tcpSocket.close();
+    close();
+}
+
+void Session::close() {
+    boost::system::error_code ec;
+    m_closed = true;
+    IdleWheel::remove(&m_idleNode);
+    m_socket.shutdown(m_socket.shutdown_both, ec);
+    m_socket.close(ec);
+}
+
+// m_shutHandler从连接字典中移除Session并关闭连接，调用者持有shared_ptr
+void Session::shutdown(const std::string& reason) {
+    if (m_closed) return;
+    if (m_shutHandler) {
+        std::string message = reason;
+        m_shutHandler(*this, message);
+    }
+}
+
+bool Session::parseNext(std::vector<std::string_view>& cmd) {
+    if (m_protocol == RespProtocol) {
+        return m_respParser.next(m_recvBuffer->data(), m_recvSize, cmd);
+    }
+    return m_parser.next(m_recvBuffer->data(), m_recvSize, cmd);
+}
+
+size_t Session::getFrameStart() const {
+    if (m_protocol == RespProtocol) {
+        return m_respParser.getFrameStart();
+    }
+    return m_parser.getFrameStart();
+}
+
+size_t Session::getFrameHint() const {
+    if (m_protocol == RespProtocol) {
+        return m_respParser.getFrameHint();
+    }
+    return 0;
+}
+
+void Session::moveFrame(size_t offset) {
+    if (m_protocol == RespProtocol) {
+        m_respParser.moveFrame(offset);
+    } else {
+        m_parser.moveFrame(offset);
+    }
+}
+
+bool Session::dispatchBuffered() {
+    Request rq;
+    if (!parseNext(rq.cmd)) {
+        return false;
+    }
+    rq.m_session = m_handle;
+    rq.m_protocol = m_protocol;
+    rq.m_data = m_recvBuffer;
+    rq.m_sequence = m_replySequence + m_replies.size();
+    m_replies.emplace_back();
+    m_recvHandler(rq, m_stalled, isBulk());
+    return true;
+}
+
+bool Session::isBulk() const {
+    return m_replies.size() > BULK_PIPELINE;
+}
+
+bool Session::prepareBuffer() {
+    auto& buffer = *m_recvBuffer;
+    size_t start = getFrameStart();
+    size_t pending = m_recvSize - start;
+    if (isUnique(m_recvBuffer)) {
+        if (m_recvSize < buffer.size()) return true;
+        if (start > 0) {
+            std::memmove(&buffer[0], &buffer[start], pending);
+            m_recvSize = pending;
+            moveFrame(0);
+            return true;
+        }
+    }
+    // 缓冲区仍被请求引用，或者一条指令占满了整个缓冲区。已经知道指令的
+    // 长度(RESP2的bulk string)时一次分配足够的空间，较大的值不需要随着
+    // 缓冲区加倍多次拷贝
+    size_t need = std::max(pending + 1, getFrameHint());
+    if (need > (size_t)m_globalConfig->maxRequestSize) return false;
+    auto temp = m_bufferPool->acquire(need);
+    std::memcpy(&(*temp)[0], buffer.data() + start, pending);
+    m_bufferPool->release(std::move(m_recvBuffer));
+    m_recvBuffer = std::move(temp);
+    m_recvSize = pending;
+    moveFrame(0);
+    return true;
+}
+
+void Session::releaseBuffer() {
+    if (!m_recvBuffer || getFrameStart() < m_recvSize ||
+        !isUnique(m_recvBuffer)) {
+        return;
+    }
+    m_bufferPool->release(std::move(m_recvBuffer));
+    m_recvSize = 0;
+    moveFrame(0);
+}
+
+void Session::readAvailable() {
+    // 等待可读时没有不完整的指令，缓冲区可以从头使用。为超长指令扩大的
+    // 缓冲区换回原来的大小
+    size_t bufferSize = (size_t)m_globalConfig->sessionBufferSize;
+    if (!m_recvBuffer || !isUnique(m_recvBuffer) ||
+        m_recvBuffer->size() != bufferSize) {
+        m_bufferPool->release(std::move(m_recvBuffer));
+        m_recvBuffer = m_bufferPool->acquire(bufferSize);
+    }
+    m_recvSize = 0;
+    moveFrame(0);
+    auto& buffer = *m_recvBuffer;
+    boost::system::error_code ec;
+    size_t size = m_socket.read_some(
+        boost::asio::buffer(&buffer[0], buffer.size()), ec);
+    if (ec == boost::asio::error::would_block) {
+        m_readable = false;
+        async_recv();
+        return;
+    }
+    if (ec) {
+        shutdown(ec.message());
+        return;
+    }
+    m_readable = size == buffer.size();
+    m_recvSize = size;
+    m_lastAccess = m_idleWheel->getNow();
+    async_recv();
 }
 
 void Session::async_recv() {
-    m_tcpSocket.async_read_some(
-        boost::asio::buffer(m_buffer),
-        [this](const boost::system::error_code &ec, size_t size) {
-            if (!ec) {
-                if (m_recvHandler) {
-                    std::string temp = std::string(m_buffer, 0, size);
-                    m_recvHandler(m_name, temp);
+    if (m_closed || m_dispatchPosted || !m_stalled.empty()) return;
+    size_t pipeline = (size_t)m_globalConfig->sessionPipeline;
+    int64 quota = DISPATCH_QUOTA;
+    while (m_recvBuffer && quota > 0 && m_replies.size() < pipeline &&
+        dispatchBuffered()) {
+        quota--;
+        if (!m_stalled.empty()) break;
+    }
+    if (m_respParser.isError()) {
+        shutdown("Protocol error.");
+        return;
+    }
+    if (!m_stalled.empty()) {
+        // 不再读取和解析，socket的接收缓冲区满了之后客户端的写入被阻塞
+        if (m_pauseHandler) m_pauseHandler(*this);
+        return;
+    }
+    auto self = shared_from_this();
+    if (quota == 0) {
+        m_dispatchPosted = true;
+        boost::asio::post(m_socket.get_executor(), [this, self]() {
+            m_dispatchPosted = false;
+            async_recv();
+        });
+        return;
+    }
+    releaseBuffer();
+    if (m_reading || m_replies.size() >= pipeline) return;
+    m_reading = true;
+    if (!m_recvBuffer || getFrameStart() == m_recvSize) {
+        if (m_readable) {
+            boost::asio::post(m_socket.get_executor(), [this, self]() {
+                m_reading = false;
+                if (!m_closed) readAvailable();
+            });
+            return;
+        }
+        // 零字节的读操作：等待数据到达，不占用缓冲区
+        m_socket.async_wait(StreamSocket::wait_read,
+            [this, self](const boost::system::error_code &ec) {
+                m_reading = false;
+                if (m_closed) return;
+                if (!ec) {
+                    readAvailable();
+                } else {
+                    shutdown(ec.message());
                 }
-                m_lastAccess = getCurrentTime();
+            });
+        return;
+    }
+    if (!prepareBuffer()) {
+        m_reading = false;
+        shutdown("Request is too large.");
+        return;
+    }
+    auto& buffer = *m_recvBuffer;
+    size_t space = buffer.size() - m_recvSize;
+    m_socket.async_read_some(
+        boost::asio::buffer(&buffer[m_recvSize], space),
+        [this, self, space](const boost::system::error_code &ec, size_t size) {
+            m_reading = false;
+            if (m_closed) return;
+            if (!ec) {
+                m_readable = size == space;
+                m_recvSize += size;
+                m_lastAccess = m_idleWheel->getNow();
+                async_recv();
             } else {
-                if (m_shutHandler) {
-                    m_shutHandler(m_name, ec.message());
-                    m_deadTimer.cancel();
-                }
+                shutdown(ec.message());
             }
         });
 }
-void Session::aysnc_send(const std::string &result) {
-    m_buffer.replace(0, result.size(), result);
-    boost::asio::async_write(
-        m_tcpSocket, boost::asio::buffer(m_buffer, result.size()),
-        [this](const boost::system::error_code &ec, size_t size) {
-            if (!ec) {
-                if (m_sendHandler) {
-                    std::string temp = std::string(m_buffer, 0, size);
-                    m_sendHandler(m_name, temp);
-                }
-                async_recv();
-            } else {
-                if (m_shutHandler) {
-                    m_shutHandler(m_name, ec.message());
-                    m_deadTimer.cancel();
-                }
+
+bool Session::resume() {
+    if (m_closed) return true;
+    std::vector<Request> stalled;
+    stalled.swap(m_stalled);
+    size_t i = 0;
+    while (i < stalled.size() && m_stalled.empty()) {
+        m_recvHandler(stalled[i++], m_stalled, isBulk());
+    }
+    if (!m_stalled.empty()) {
+        // 同一个分片的请求必须保持原来的顺序，第一个失败之后不再尝试
+        m_stalled.insert(m_stalled.end(),
+            std::make_move_iterator(stalled.begin() + i),
+            std::make_move_iterator(stalled.end()));
+        return false;
+    }
+    async_recv();
+    return true;
+}
+
+bool Session::addReply(uint64_t sequence, Reply&& result) {
+    if (m_closed || sequence < m_replySequence ||
+        sequence - m_replySequence >= m_replies.size()) {
+        return false;
+    }
+    auto& slot = m_replies[sequence - m_replySequence];
+    slot.m_ready = true;
+    slot.m_reply = std::move(result);
+    if (m_flushQueued) return false;
+    m_flushQueued = true;
+    return true;
+}
+
+// 文本协议的结果格式为"<长度>\n<内容>"，RESP2协议的结果已经由执行线程
+// 编码。同一时间只有一个async_write，期间完成的结果在写操作完成之后
+// 一起写回
+void Session::flushReplies() {
+    m_flushQueued = false;
+    if (m_closed || !m_sendReplies.empty()) return;
+    size_t inlineSize = 0;
+    while (!m_replies.empty() && m_replies.front().m_ready) {
+        auto& reply = m_replies.front().m_reply;
+        // 长度前缀，以及RESP2中引用的值之后的"\r\n"
+        inlineSize += MAX_HEADER_SIZE + 2;
+        if (reply.m_data.size() <= MAX_INLINE_REPLY) {
+            inlineSize += reply.m_data.size();
+        }
+        m_sendReplies.push_back(std::move(reply));
+        m_replies.pop_front();
+        m_replySequence++;
+    }
+    if (m_sendReplies.empty()) return;
+    // 预先分配空间，m_sendBuffers中指向m_sendBuffer的指针保持有效
+    m_sendBuffer.clear();
+    m_sendBuffer.reserve(inlineSize);
+    m_sendBuffers.clear();
+    size_t start = 0;
+    // m_sendBuffer中还没有加入m_sendBuffers的部分
+    auto addInline = [this, &start]() {
+        if (m_sendBuffer.size() > start) {
+            m_sendBuffers.emplace_back(m_sendBuffer.data() + start,
+                m_sendBuffer.size() - start);
+            start = m_sendBuffer.size();
+        }
+    };
+    for (auto& reply : m_sendReplies) {
+        if (m_protocol == TextProtocol) {
+            m_sendBuffer += std::to_string(reply.size());
+            m_sendBuffer += '\n';
+        }
+        auto& data = reply.m_data;
+        if (data.size() <= MAX_INLINE_REPLY) {
+            m_sendBuffer += data;
+        } else {
+            addInline();
+            m_sendBuffers.emplace_back(data.data(), data.size());
+        }
+        if (!reply.m_value) continue;
+        addInline();
+        m_sendBuffers.emplace_back(reply.m_value.data(),
+            reply.m_value.size());
+        if (m_protocol == RespProtocol) m_sendBuffer += "\r\n";
+    }
+    addInline();
+    auto self = shared_from_this();
+    boost::asio::async_write(m_socket, m_sendBuffers,
+        [this, self](const boost::system::error_code &ec, size_t) {
+            if (m_closed) return;
+            if (ec) {
+                shutdown(ec.message());
+                return;
             }
+            m_sendReplies.clear();
+            m_sendBuffers.clear();
+            flushReplies();
+            // 正在处理的指令减少，继续处理缓冲区中的指令或者恢复读取
+            async_recv();
         });
 }
 
-void Session::setSendHandler(Handler handler) { m_sendHandler = handler; }
-void Session::setRecvHandler(Handler handler) { m_recvHandler = handler; }
-void Session::setShutHandler(Handler handler) { m_shutHandler = handler; }
+void Session::setRecvHandler(RequestHandler handler) {
+    m_recvHandler = handler;
+}
+void Session::setShutHandler(ShutHandler handler) {
+    m_shutHandler = handler;
+}
+void Session::setPauseHandler(PauseHandler handler) {
+    m_pauseHandler = handler;
+}
 
 std::string Session::getPeer() { return m_name; }
+SessionHandle Session::getHandle() { return m_handle; }
+void Session::setHandle(SessionHandle handle) { m_handle = handle; }
 
-SessionManager::SessionManager()
-    : m_globalConfig(getGlobalConfig()),
-    m_endpoint(boost::asio::ip::tcp::v4(), m_globalConfig->listeningPort),
-    m_acceptor(m_ioService, m_endpoint), m_tcpSocket(m_ioService) {
-    std::cout << "Lisening port: " + std::to_string(m_endpoint.port()) << std::endl;
+// 打开监听socket，支持SO_REUSEPORT时每个I/O线程监听同一个端口
+static void openAcceptor(Acceptor& acceptor, const Endpoint& endpoint) {
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(Acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+    // 每个I/O线程一个监听socket，由内核分配新连接
+    using ReusePort = boost::asio::detail::socket_option::boolean<
+        SOL_SOCKET, SO_REUSEPORT>;
+    acceptor.set_option(ReusePort(true));
+#endif
+    acceptor.bind(endpoint);
+    acceptor.listen();
 }
 
-SessionManager::~SessionManager() {
-    for (auto &e : m_sessionTable) {
-        delete e.second;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+// 上次运行留下的socket文件会导致bind失败，只删除socket类型的文件
+static void openAcceptor(LocalAcceptor& acceptor, const std::string& path) {
+    std::error_code ec;
+    if (std::filesystem::is_socket(path, ec)) {
+        std::filesystem::remove(path, ec);
+    }
+    LocalAcceptor::endpoint_type endpoint(path);
+    acceptor.open(endpoint.protocol());
+    acceptor.bind(endpoint);
+    acceptor.listen();
+}
+#endif
+
+// 连接已经断开时返回false
+static bool getPeerName(TcpSocket& sock, std::string& name) {
+    boost::system::error_code ec;
+    auto endpoint = sock.remote_endpoint(ec);
+    if (ec) {
+        std::cout << ec.message() << std::endl;
+        return false;
+    }
+    name = endpoint.address().to_string() + ":" +
+        std::to_string(endpoint.port());
+    return true;
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+// 客户端的socket通常没有绑定路径，使用监听路径和fd区分连接
+static bool getPeerName(LocalSocket& sock, std::string& name) {
+    boost::system::error_code ec;
+    sock.remote_endpoint(ec);
+    if (ec) {
+        std::cout << ec.message() << std::endl;
+        return false;
+    }
+    name = "unix:" + sock.local_endpoint(ec).path() + ":" +
+        std::to_string(sock.native_handle());
+    return true;
+}
+#endif
+
+BufferPool::BufferPool(size_t baseSize)
+    : m_baseSize(baseSize), m_classes(POOL_CLASS_COUNT) {}
+
+size_t BufferPool::getClass(size_t size) const {
+    size_t index = 0;
+    size_t classSize = m_baseSize;
+    while (classSize < size && index < m_classes.size()) {
+        classSize *= 2;
+        index++;
+    }
+    return index;
+}
+
+RequestData BufferPool::acquire(size_t size) {
+    size_t index = getClass(size);
+    if (index == m_classes.size()) {
+        // 超过最大一级的缓冲区不放回池中，大小仍然按照2的幂增长
+        size_t bufferSize = m_baseSize << index;
+        while (bufferSize < size) bufferSize *= 2;
+        return std::make_shared<std::string>(bufferSize, '\0');
+    }
+    auto& buffers = m_classes[index];
+    if (buffers.empty()) {
+        return std::make_shared<std::string>(m_baseSize << index, '\0');
+    }
+    auto buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void BufferPool::release(RequestData&& buffer) {
+    auto temp = std::move(buffer);
+    if (!temp || !isUnique(temp)) return;
+    size_t index = getClass(temp->size());
+    if (index == m_classes.size() || temp->size() != m_baseSize << index) {
+        return;
+    }
+    auto& buffers = m_classes[index];
+    if ((buffers.size() + 1) * temp->size() <= POOL_CLASS_MEMORY) {
+        buffers.push_back(std::move(temp));
+    }
+}
+
+SessionWorker::SessionWorker(int64 index, const Endpoint& endpoint,
+    const Endpoint& respEndpoint, bool listen)
+    : m_globalConfig(getGlobalConfig()), m_index(index),
+    m_acceptor(m_ioService), m_respAcceptor(m_ioService),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    m_localAcceptor(m_ioService),
+#endif
+    m_bufferPool((size_t)m_globalConfig->sessionBufferSize),
+    m_idleWheel(m_globalConfig->sessionDuration, IdleWheel::now()),
+    m_idleTimer(m_ioService), m_resumeTimer(m_ioService) {
+    if (!listen) return;
+    openAcceptor(m_acceptor, endpoint);
+    if (m_globalConfig->respPort > 0) {
+        openAcceptor(m_respAcceptor, respEndpoint);
+    }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (index == 0 && !m_globalConfig->unixSocket.empty()) {
+        openAcceptor(m_localAcceptor, m_globalConfig->unixSocket);
+    }
+#endif
+}
+
+SessionWorker::~SessionWorker() {
+    for (auto &slot : m_sessionSlots) {
+        if (slot.m_session) slot.m_session->close();
+    }
+    m_sessionSlots.clear();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (m_localAcceptor.is_open()) {
+        boost::system::error_code ec;
+        m_localAcceptor.close(ec);
+        std::error_code removeError;
+        std::filesystem::remove(m_globalConfig->unixSocket, removeError);
+    }
+#endif
+    auto completion = m_completions.exchange(nullptr);
+    while (completion) {
+        std::unique_ptr<Completion> temp(completion);
+        completion = completion->m_next;
     }
     m_ioService.stop();
 }
 
-void SessionManager::runManager() {
-    async_accept();
+void SessionWorker::run() {
+    if (m_acceptor.is_open()) {
+        async_accept(m_acceptor, TextProtocol);
+    }
+    if (m_respAcceptor.is_open()) {
+        async_accept(m_respAcceptor, RespProtocol);
+    }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (m_localAcceptor.is_open()) {
+        async_accept(m_localAcceptor, TextProtocol);
+    }
+#endif
+    scheduleIdle();
+    // 没有连接时保持运行
+    auto work = boost::asio::make_work_guard(m_ioService);
     m_ioService.run();
 }
 
-void SessionManager::async_send(const std::string &name, const std::string &result) {
-    if (m_sessionTable.find(name) == m_sessionTable.end())
+void SessionWorker::async_send(SessionHandle session, uint64_t sequence,
+    Reply result) {
+    auto completion = new Completion{ nullptr, session, sequence,
+        std::move(result) };
+    auto head = m_completions.load(std::memory_order_relaxed);
+    do {
+        completion->m_next = head;
+    } while (!m_completions.compare_exchange_weak(head, completion,
+        std::memory_order_release, std::memory_order_relaxed));
+    // 链表原来不为空时已经投递过drainCompletions，还没有执行
+    if (!head) {
+        boost::asio::post(m_ioService, [this]() { drainCompletions(); });
+    }
+}
+
+void SessionWorker::drainCompletions() {
+    // 链表为后进先出，结果按照序号放入槽位，不依赖取出的顺序
+    auto completion = m_completions.exchange(nullptr,
+        std::memory_order_acquire);
+    while (completion) {
+        std::unique_ptr<Completion> temp(completion);
+        completion = completion->m_next;
+        auto session = findSession(temp->m_session);
+        if (session && session->addReply(temp->m_sequence,
+            std::move(temp->m_result))) {
+            m_flushSessions.push_back(session->shared_from_this());
+        }
+    }
+    for (auto& session : m_flushSessions) {
+        session->flushReplies();
+    }
+    m_flushSessions.clear();
+    // 执行线程取出了请求，分片的队列可能已经有空位
+    if (!m_pausedSessions.empty()) resumeSessions();
+}
+
+void SessionWorker::pauseSession(SessionHandle session) {
+    m_pausedSessions.push_back(session);
+    m_pausedCount++;
+    m_pauseTotal++;
+    scheduleResume();
+}
+
+void SessionWorker::resumeSessions() {
+    // 本轮恢复之后再次暂停的连接排在队尾，下一轮再重试
+    size_t count = m_pausedSessions.size();
+    for (size_t i = 0; i < count; i++) {
+        auto handle = m_pausedSessions.front();
+        m_pausedSessions.pop_front();
+        auto session = findSession(handle);
+        if (session) {
+            // resume中可能关闭连接
+            auto self = session->shared_from_this();
+            if (!session->resume()) {
+                m_pausedSessions.push_back(handle);
+                continue;
+            }
+        }
+        m_pausedCount--;
+    }
+    scheduleResume();
+}
+
+void SessionWorker::scheduleResume() {
+    if (m_resumeScheduled || m_pausedSessions.empty()) return;
+    m_resumeScheduled = true;
+    m_resumeTimer.expires_from_now(bpt::microsec(RESUME_INTERVAL));
+    m_resumeTimer.async_wait([this](const boost::system::error_code &ec) {
+        m_resumeScheduled = false;
+        if (!ec) resumeSessions();
+    });
+}
+
+void SessionWorker::scheduleIdle() {
+    m_idleTimer.expires_from_now(
+        std::chrono::milliseconds(m_idleWheel.getTickSize()));
+    m_idleTimer.async_wait([this](const boost::system::error_code &ec) {
+        if (ec) return;
+        m_idleWheel.advance(IdleWheel::now(), [](IdleNode* node) {
+            // 关闭连接时可能释放Session
+            auto self = node->m_session->shared_from_this();
+            self->checkIdle();
+        });
+        scheduleIdle();
+    });
+}
+
+void SessionWorker::addSession(StreamSocket sock, RequestProtocol protocol,
+    std::string name) {
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else if (m_sessionSlots.size() < MAX_SESSION_SLOTS) {
+        slot = (uint32_t)m_sessionSlots.size();
+        m_sessionSlots.emplace_back();
+    } else {
+        std::cout << "Too many sessions." << std::endl;
         return;
-    m_sessionTableLock.lock();
-    auto session = m_sessionTable[name];
-    m_sessionTableLock.unlock();
-    session->aysnc_send(result);
-}
-
-void SessionManager::async_accept() {
-    m_acceptor.async_accept(m_tcpSocket, 
-        [this](const boost::system::error_code &ec) {
-        if (!ec) {
-            auto newSession = new Session(std::move(m_tcpSocket));
-            m_sessionTableLock.lock();
-            auto sessionName = newSession->getPeer();
-            m_sessionTable[sessionName] = newSession;
-            m_sessionTableLock.unlock();
-            newSession->setRecvHandler(revcHandlerImpl);
-            newSession->setSendHandler(nullptr);
-            newSession->setShutHandler(shutHandlerImpl);
-            std::cout << "New session: " + sessionName << std::endl;
-            newSession->async_recv();
-        } else {
+    }
+    auto newSession = std::make_shared<Session>(std::move(sock),
+        std::move(name), protocol, &m_bufferPool, &m_idleWheel);
+    auto sessionName = newSession->getPeer();
+    auto& sessionSlot = m_sessionSlots[slot];
+    sessionSlot.m_session = newSession;
+    newSession->setHandle(makeSessionHandle(m_index, slot,
+        sessionSlot.m_generation));
+    m_sessionCount++;
+    newSession->setRecvHandler(revcHandlerImpl);
+    newSession->setShutHandler(shutHandlerImpl);
+    newSession->setPauseHandler(pauseHandlerImpl);
+    std::cout << "New session: " + sessionName << std::endl;
+    newSession->start();
+}
+
+// 支持SO_REUSEPORT时每个I/O线程接受自己的TCP连接；否则以及unix domain
+// socket的连接由第0个I/O线程接受，轮流分配给各个I/O线程
+template <typename AcceptorType>
+void SessionWorker::async_accept(AcceptorType& acceptor,
+    RequestProtocol protocol) {
+    using Socket = typename AcceptorType::protocol_type::socket;
+    auto manager = getSessionManager();
+    bool reusePort = manager->m_reusePort &&
+        std::is_same<AcceptorType, Acceptor>::value;
+    auto worker = reusePort ? this : manager->getNextWorker();
+    acceptor.async_accept(worker->getIOService(),
+        [this, worker, &acceptor, protocol](
+            const boost::system::error_code &ec, Socket sock) {
+        std::string name;
+        if (ec) {
             std::cout << ec.message() << std::endl;
+        } else if (getPeerName(sock, name)) {
+            // socket已经属于目标I/O线程的io_service
+            StreamSocket stream(std::move(sock));
+            if (worker == this) {
+                addSession(std::move(stream), protocol, std::move(name));
+            }
+            else {
+                auto socket = std::make_shared<StreamSocket>(
+                    std::move(stream));
+                boost::asio::post(worker->getIOService(),
+                    [worker, socket, protocol, name]() {
+                    worker->addSession(std::move(*socket), protocol, name);
+                });
+            }
         }
-        async_accept();
+        async_accept(acceptor, protocol);
     });
 }
 
-int64 SessionManager::getSessionCount() { return m_sessionTable.size(); }
+Session* SessionWorker::findSession(SessionHandle session) {
+    uint32_t slot = getHandleSlot(session);
+    if (slot >= m_sessionSlots.size()) return nullptr;
+    auto& sessionSlot = m_sessionSlots[slot];
+    if (sessionSlot.m_generation != getHandleGeneration(session)) {
+        return nullptr;
+    }
+    return sessionSlot.m_session.get();
+}
 
-void SessionManager::shutSession(const std::string &peer) {
-    if (m_sessionTable.find(peer) == m_sessionTable.end()) {
-        return;
+void SessionWorker::shutSession(SessionHandle session) {
+    if (!findSession(session)) return;
+    uint32_t slot = getHandleSlot(session);
+    auto& sessionSlot = m_sessionSlots[slot];
+    auto temp = std::move(sessionSlot.m_session);
+    // 代数从1开始，回绕时跳过0
+    if (++sessionSlot.m_generation == 0) sessionSlot.m_generation = 1;
+    m_freeSlots.push_back(slot);
+    m_sessionCount--;
+    temp->close();
+}
+
+int64 SessionWorker::getSessionCount() { return m_sessionCount; }
+int64 SessionWorker::getPausedCount() { return m_pausedCount; }
+int64 SessionWorker::getPauseTotal() { return m_pauseTotal; }
+
+IOService& SessionWorker::getIOService() { return m_ioService; }
+
+
+SessionManager::SessionManager()
+    : m_globalConfig(getGlobalConfig()),
+    m_endpoint(boost::asio::ip::tcp::v4(), m_globalConfig->listeningPort),
+    m_respEndpoint(boost::asio::ip::tcp::v4(), m_globalConfig->respPort) {
+#ifdef SO_REUSEPORT
+    m_reusePort = true;
+#else
+    m_reusePort = false;
+#endif
+    int64 count = std::min(MAX_IO_THREADS,
+        std::max<int64>(1, m_globalConfig->ioThreadCount));
+    for (int64 i = 0; i < count; i++) {
+        m_workers.push_back(new SessionWorker(i, m_endpoint, m_respEndpoint,
+            m_reusePort || i == 0));
+    }
+    std::cout << "Lisening port: " + std::to_string(m_endpoint.port()) +
+        ", I/O threads: " + std::to_string(count) << std::endl;
+    if (m_globalConfig->respPort > 0) {
+        std::cout << "Lisening RESP port: " +
+            std::to_string(m_respEndpoint.port()) << std::endl;
+    }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (!m_globalConfig->unixSocket.empty()) {
+        std::cout << "Lisening unix socket: " + m_globalConfig->unixSocket
+            << std::endl;
+    }
+#else
+    if (!m_globalConfig->unixSocket.empty()) {
+        std::cout << "Unix domain socket is not supported." << std::endl;
+    }
+#endif
+}
+
+SessionManager::~SessionManager() {
+    for (auto worker : m_workers) {
+        delete worker;
+    }
+}
+
+void SessionManager::runManager() {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        threads.emplace_back(&SessionWorker::run, m_workers[i]);
+    }
+    m_workers[0]->run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void SessionManager::async_send(const Request &rq, Reply result) {
+    m_workers[getHandleWorker(rq.m_session)]->async_send(rq.m_session,
+        rq.m_sequence, std::move(result));
+}
+
+int64 SessionManager::getSessionCount() {
+    int64 count = 0;
+    for (auto worker : m_workers) {
+        count += worker->getSessionCount();
     }
-    auto session = m_sessionTable[peer];
-    delete session;
-    m_sessionTable.erase(peer);
+    return count;
+}
+
+int64 SessionManager::getPausedCount() {
+    int64 count = 0;
+    for (auto worker : m_workers) {
+        count += worker->getPausedCount();
+    }
+    return count;
+}
+
+int64 SessionManager::getPauseTotal() {
+    int64 count = 0;
+    for (auto worker : m_workers) {
+        count += worker->getPauseTotal();
+    }
+    return count;
+}
+
+void SessionManager::shutSession(SessionHandle session) {
+    m_workers[getHandleWorker(session)]->shutSession(session);
+}
+
+void SessionManager::pauseSession(SessionHandle session) {
+    m_workers[getHandleWorker(session)]->pauseSession(session);
+}
+
+// 只在接受连接的I/O线程中调用
+SessionWorker* SessionManager::getNextWorker() {
+    auto worker = m_workers[m_nextWorker];
+    m_nextWorker = (m_nextWorker + 1) % (int64)m_workers.size();
+    return worker;
 }
 
 SessionManager* getSessionManager() {
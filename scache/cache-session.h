@@ -1,89 +1,326 @@
 #pragma once
 
 #include "request-buffer.h"
+#include "request-parser.h"
+#include "request-resp.h"
+#include "cache-timer.h"
 #include <boost/asio.hpp>
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
-#include <unordered_map>
+#include <vector>
 #include "cache-config.h"
 
 using TcpSocket = boost::asio::ip::tcp::socket;
 using Acceptor = boost::asio::ip::tcp::acceptor;
+// Session使用的socket，TCP和unix domain socket的连接都转换为该类型
+using StreamSocket = boost::asio::generic::stream_protocol::socket;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+using LocalSocket = boost::asio::local::stream_protocol::socket;
+using LocalAcceptor = boost::asio::local::stream_protocol::acceptor;
+#endif
 using Endpoint = boost::asio::ip::tcp::endpoint;
 using Address = boost::asio::ip::address;
 using IOService = boost::asio::io_service;
 using DeadTimer = boost::asio::deadline_timer;
+using SteadyTimer = boost::asio::steady_timer;
 
-using Handler = void (*)(std::string&, std::string&);
+// 接收到一条完整的指令。分片的队列已满时请求移动到第二个参数中，第三个
+// 参数表示连接中正在处理的指令较多
+using RequestHandler = void (*)(Request&, std::vector<Request>&, bool);
+class Session;
+class BufferPool;
+// 连接关闭，参数为关闭的原因
+using ShutHandler = void (*)(Session&, std::string&);
+// 连接因为分片的队列已满而暂停读取
+using PauseHandler = void (*)(Session&);
 
-class Session {
+// I/O线程数量的上限，受SessionHandle中I/O线程序号的位数限制
+const int64 MAX_IO_THREADS = 256;
+// 每个I/O线程的连接数量上限，受SessionHandle中槽位的位数限制
+const uint32_t MAX_SESSION_SLOTS = 1 << 24;
+
+inline SessionHandle makeSessionHandle(int64 worker, uint32_t slot,
+    uint32_t generation) {
+    return ((SessionHandle)generation << 32) | ((SessionHandle)slot << 8) |
+        (SessionHandle)worker;
+}
+inline int64 getHandleWorker(SessionHandle handle) {
+    return (int64)(handle & 0xff);
+}
+inline uint32_t getHandleSlot(SessionHandle handle) {
+    return (uint32_t)(handle >> 8) & (MAX_SESSION_SLOTS - 1);
+}
+inline uint32_t getHandleGeneration(SessionHandle handle) {
+    return (uint32_t)(handle >> 32);
+}
+
+// 连接：持续读取和解析指令，一个连接可以同时有多条指令正在处理(流水线)。
+// 每条指令按照接收顺序得到一个序号，结果按照序号顺序写回。异步操作的
+// 回调持有Session的shared_ptr，连接关闭之后最后一个回调完成时回收
+class Session : public std::enable_shared_from_this<Session> {
 private:
-    TcpSocket m_tcpSocket;
-    std::string m_buffer;
+    StreamSocket m_socket;
+    // 接收缓冲区：m_recvSize之前为已经接收的数据，其中m_parser已经处理到
+    // 的指令由Request引用。缓冲区仍被引用时，新的数据写入新的缓冲区。
+    // 没有不完整的指令时先等待socket可读，可读之后才从m_bufferPool借用
+    // 缓冲区，不再被引用时归还，空闲的连接不占用接收缓冲区
+    RequestData m_recvBuffer;
+    size_t m_recvSize = 0;
+    BufferPool* m_bufferPool;
+    // 上次读取填满了缓冲区，socket中可能还有数据。asio的epoll为边沿触发，
+    // 这时等待可读不会返回，需要直接读取
+    bool m_readable = false;
+    // 连接的协议决定使用哪一个解析器以及结果的编码方式
+    RequestProtocol m_protocol;
+    RequestParser m_parser;
+    RespParser m_respParser;
+    bool m_reading = false;
+    // 因为分片的队列已满没有提交的请求，不为空时连接暂停读取和解析，
+    // 由所属的SessionWorker调用resume按顺序重新提交
+    std::vector<Request> m_stalled;
+    // 本轮提交的指令达到上限，剩余的指令已经投递到io_service
+    bool m_dispatchPosted = false;
+
+    // 正在处理和等待写回的结果，第一个元素的序号为m_replySequence
+    struct ReplySlot {
+        bool m_ready = false;
+        Reply m_reply;
+    };
+    std::deque<ReplySlot> m_replies;
+    uint64_t m_replySequence = 0;
+    // 正在写回的结果。较短的结果和文本协议的长度前缀拷贝到m_sendBuffer，
+    // 较长的结果和结果引用的值直接作为单独的缓冲区，一次writev写回
+    std::vector<Reply> m_sendReplies;
+    std::string m_sendBuffer;
+    std::vector<boost::asio::const_buffer> m_sendBuffers;
+    // 已经加入所属SessionWorker的待写回列表
+    bool m_flushQueued = false;
+    bool m_closed = false;
+
+    // TCP连接为ip:port，unix domain socket的连接为unix:路径:fd，只用于
+    // 日志；加锁的所有者使用连接句柄，不依赖对端地址
     std::string m_name;
+    SessionHandle m_handle = INVALID_SESSION;
 
-    DeadTimer m_deadTimer;
+    // 所属I/O线程的空闲时间轮，连接关闭时从时间轮移除
+    IdleWheel* m_idleWheel;
+    IdleNode m_idleNode;
 
     GlobalConfig* m_globalConfig;
 
-    Handler m_sendHandler;
-    Handler m_recvHandler;
-    Handler m_shutHandler;
+    RequestHandler m_recvHandler;
+    ShutHandler m_shutHandler;
+    PauseHandler m_pauseHandler;
 
+    // 最后一次读取数据的时间，使用时间轮缓存的时钟
     int64 m_lastAccess;
 
-    void setDeadTimer(int64 time);
+    // 按照连接的协议解析
+    bool parseNext(std::vector<std::string_view>& cmd);
+    size_t getFrameStart() const;
+    // 当前指令至少还需要的长度(从指令起始位置开始)，不知道时为0
+    size_t getFrameHint() const;
+    void moveFrame(size_t offset);
+    // 处理缓冲区中的下一条完整指令，没有时返回false
+    bool dispatchBuffered();
+    // 正在处理的指令较多的连接不能占满分片的队列
+    bool isBulk() const;
+    // 保证接收缓冲区有剩余空间，必要时把不完整的指令移动到缓冲区开头
+    bool prepareBuffer();
+    // 没有不完整的指令并且缓冲区不再被请求引用时归还缓冲区
+    void releaseBuffer();
+    // socket可读之后取得缓冲区，非阻塞地读取已经到达的数据
+    void readAvailable();
+    void shutdown(const std::string& reason);
 
 public:
-    Session(TcpSocket sock);
+    Session(StreamSocket sock, std::string name, RequestProtocol protocol,
+        BufferPool* bufferPool, IdleWheel* idleWheel);
     virtual ~Session();
+    // 启动超时检测并开始读取，需要在创建shared_ptr之后调用
+    void start();
+    // 空闲时间轮的槽位到期：超过sessionDuration没有读取数据时关闭连接，
+    // 否则按照最后访问时间重新放入时间轮
+    void checkIdle();
+    // 处理缓冲区中完整的指令，并继续从socket读取数据。正在处理的指令
+    // 达到sessionPipeline时暂停读取，结果写回之后继续；分片的队列已满时
+    // 暂停读取，直到resume成功
     void async_recv();
-    void aysnc_send(const std::string &result);
-    void setSendHandler(Handler handler);
-    void setRecvHandler(Handler handler);
-    void setShutHandler(Handler handler);
+    // 按顺序重新提交暂停时没有提交的请求，全部提交之后恢复读取并返回true
+    bool resume();
+    // 序号为sequence的指令的结果，需要写回时返回true(每次flushReplies
+    // 之前只返回一次)
+    bool addReply(uint64_t sequence, Reply&& result);
+    // 把已经返回的连续结果写回
+    void flushReplies();
+    // 关闭socket，取消所有异步操作
+    void close();
+    void setRecvHandler(RequestHandler handler);
+    void setShutHandler(ShutHandler handler);
+    void setPauseHandler(PauseHandler handler);
 
     std::string getPeer();
+    SessionHandle getHandle();
+    void setHandle(SessionHandle handle);
 };
 
-class SessionManager {
-  private:
-    std::unordered_map<std::string, Session*> m_sessionTable;
-    std::mutex m_sessionTableLock;
+using SessionPtr = std::shared_ptr<Session>;
+
+// 接收缓冲区池，每个I/O线程一个，只在该线程中使用，不需要加锁。缓冲区
+// 按照大小分级，第k级为sessionBufferSize的2^k倍；每一级空闲缓冲区的
+// 总大小有上限，超过上限以及更大的缓冲区直接释放
+class BufferPool {
+private:
+    size_t m_baseSize;
+    std::vector<std::vector<RequestData>> m_classes;
+
+    // 不小于size的最小一级，超过最大一级时返回m_classes.size()
+    size_t getClass(size_t size) const;
+
+public:
+    explicit BufferPool(size_t baseSize);
+
+    // 取得至少size字节的缓冲区
+    RequestData acquire(size_t size);
+    // 归还缓冲区。仍被请求引用的缓冲区不放回池中，由最后一个引用释放
+    void release(RequestData&& buffer);
+};
+
+// 一个I/O线程：独立的io_service、acceptor和连接字典。Session只在所属的
+// I/O线程中创建、读写和销毁，连接字典不需要加锁
+class SessionWorker {
+private:
+    // 连接槽位：句柄中的槽位序号直接索引，代数不同的句柄已经失效
+    struct SessionSlot {
+        uint32_t m_generation = 1;
+        SessionPtr m_session;
+    };
+    std::vector<SessionSlot> m_sessionSlots;
+    std::vector<uint32_t> m_freeSlots;
 
     GlobalConfig* m_globalConfig;
 
-    Endpoint  m_endpoint;
+    int64 m_index;
     IOService m_ioService;
     Acceptor  m_acceptor;
-    TcpSocket m_tcpSocket;
+    // RESP2协议的监听socket，没有配置respPort时不打开
+    Acceptor  m_respAcceptor;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    // unix domain socket的监听socket，只由第0个I/O线程打开
+    LocalAcceptor m_localAcceptor;
+#endif
+
+    std::atomic<int64> m_sessionCount{ 0 };
+
+    // 本I/O线程所有连接共享的接收缓冲区
+    BufferPool m_bufferPool;
+
+    // 所有连接的空闲超时由一个时间轮和一个定时器检查
+    IdleWheel m_idleWheel;
+    SteadyTimer m_idleTimer;
+
+    // 因为分片的队列已满而暂停的连接，按照暂停的顺序轮流重新提交。收到
+    // 执行线程的结果时(队列已经有空位)重试一次，另外由定时器定期重试
+    std::deque<SessionHandle> m_pausedSessions;
+    DeadTimer m_resumeTimer;
+    bool m_resumeScheduled = false;
+    std::atomic<int64> m_pausedCount{ 0 };
+    std::atomic<int64> m_pauseTotal{ 0 };
+
+    // 完成队列：执行线程把结果压入无锁链表，链表由空变为非空时投递一次
+    // drainCompletions，I/O线程一次取出所有结果
+    struct Completion {
+        Completion* m_next;
+        SessionHandle m_session;
+        uint64_t m_sequence;
+        Reply m_result;
+    };
+    std::atomic<Completion*> m_completions{ nullptr };
+    // 本次drainCompletions中收到结果的Session
+    std::vector<SessionPtr> m_flushSessions;
+
+public:
+    SessionWorker(int64 index, const Endpoint& endpoint,
+        const Endpoint& respEndpoint, bool listen);
+    virtual ~SessionWorker();
+
+    void run();
+
+    // 把结果加入完成队列，由I/O线程写回，可以在任意线程调用
+    void async_send(SessionHandle session, uint64_t sequence, Reply result);
+    // 在I/O线程中创建Session
+    void addSession(StreamSocket sock, RequestProtocol protocol,
+        std::string name);
+    // 以下只能在I/O线程中调用。句柄已经失效时返回nullptr
+    Session* findSession(SessionHandle session);
+    void shutSession(SessionHandle session);
+    void pauseSession(SessionHandle session);
+
+    int64 getSessionCount();
+    // 当前暂停的连接数量和累计暂停的次数
+    int64 getPausedCount();
+    int64 getPauseTotal();
+    IOService& getIOService();
+
+private:
+    template <typename AcceptorType>
+    void async_accept(AcceptorType& acceptor, RequestProtocol protocol);
+    // 取出完成队列中的所有结果，每个Session合并为一次写回
+    void drainCompletions();
+    // 每个暂停的连接按照顺序重试一次，仍然失败的连接排到队尾
+    void resumeSessions();
+    void scheduleResume();
+    // 每个槽位推进一次空闲时间轮
+    void scheduleIdle();
+};
+
+class SessionManager {
+private:
+    std::vector<SessionWorker*> m_workers;
+    // 不支持SO_REUSEPORT时第0个I/O线程接受连接，轮流分配给各个I/O线程
+    bool m_reusePort;
+    int64 m_nextWorker = 0;
+
+    GlobalConfig* m_globalConfig;
+
+    Endpoint  m_endpoint;
+    Endpoint  m_respEndpoint;
 
     SessionManager();
     virtual ~SessionManager();
 
 public:
+    // 启动所有I/O线程，当前线程运行第0个I/O线程
     void runManager();
 
-    void async_send(const std::string &name, const std::string &result);
+    // 结果发送给请求所在的I/O线程
+    void async_send(const Request &rq, Reply result);
 
     int64 getSessionCount();
+    int64 getPausedCount();
+    int64 getPauseTotal();
 
-    void shutSession(const std::string &peer);
+    // 关闭Session，只能在Session所在的I/O线程中调用
+    void shutSession(SessionHandle session);
+    // 暂停的连接加入所在I/O线程的重试队列，只能在该I/O线程中调用
+    void pauseSession(SessionHandle session);
 
     friend SessionManager* getSessionManager();
     friend void delSessionManager();
+    friend class SessionWorker;
 
-  private:
-    void async_accept();
+private:
+    SessionWorker* getNextWorker();
 };
 
 SessionManager* getSessionManager();
 void delSessionManager();
 
-inline int64 getCurrentTime();
-
-void startSession();
\ No newline at end of file
+void startSession();
@@ -0,0 +1,233 @@
+#include "cache-timer.h"
+#include <algorithm>
+
+// 每处理若干个节点检查一次是否超时，避免频繁读取时钟
+const int64 CLOCK_CHECK_MASK = 63;
+// 空闲时间轮一个sessionDuration分成的槽位数量，以及槽位的最小跨度
+const int64 IDLE_WHEEL_TICKS = 256;
+const int64 MIN_IDLE_TICK = 10; // ms
+
+CacheTimerWheel::CacheTimerWheel(int64 now) : m_current(now) {
+    for (auto& head : m_root) {
+        head.m_prev = head.m_next = &head;
+    }
+    for (auto& level : m_levels) {
+        for (auto& head : level) {
+            head.m_prev = head.m_next = &head;
+        }
+    }
+}
+
+// 回收剩余的节点，CacheEntry不负责回收ExpireNode
+CacheTimerWheel::~CacheTimerWheel() {
+    for (auto& head : m_root) {
+        clear(&head);
+    }
+    for (auto& level : m_levels) {
+        for (auto& head : level) {
+            clear(&head);
+        }
+    }
+}
+
+void CacheTimerWheel::clear(ExpireNode* head) {
+    while (head->m_next != head) {
+        ExpireNode* node = head->m_next;
+        unlink(node);
+        delete node;
+    }
+}
+
+void CacheTimerWheel::link(ExpireNode* node) {
+    int64 expire = node->m_expireTime;
+    int64 delay = expire - m_current;
+    ExpireNode* head = nullptr;
+    if (delay < ROOT_SIZE) {
+        // 已经到期的节点放在当前槽位
+        int64 tick = delay < 0 ? m_current : expire;
+        head = &m_root[tick & (ROOT_SIZE - 1)];
+    }
+    else {
+        if (delay > MAX_DELAY) {
+            delay = MAX_DELAY;
+            expire = m_current + MAX_DELAY;
+        }
+        int level = 0;
+        int shift = ROOT_BITS + LEVEL_BITS;
+        while (delay >= (1LL << shift)) {
+            level++;
+            shift += LEVEL_BITS;
+        }
+        int64 index = (expire >> (shift - LEVEL_BITS)) & (LEVEL_SIZE - 1);
+        head = &m_levels[level][index];
+    }
+    node->m_prev = head->m_prev;
+    node->m_next = head;
+    head->m_prev->m_next = node;
+    head->m_prev = node;
+}
+
+void CacheTimerWheel::unlink(ExpireNode* node) {
+    node->m_prev->m_next = node->m_next;
+    node->m_next->m_prev = node->m_prev;
+    node->m_prev = node->m_next = nullptr;
+}
+
+// 第0层下标回到0：上一层当前槽位的节点重新放置，该层下标同样回到0时
+// 继续转移更上一层
+void CacheTimerWheel::cascade() {
+    int shift = ROOT_BITS;
+    for (int level = 0; level < LEVELS - 1; level++) {
+        int64 index = (m_current >> shift) & (LEVEL_SIZE - 1);
+        ExpireNode* head = &m_levels[level][index];
+        // 先取下整个链表，重新放置的节点可能回到同一个槽位
+        ExpireNode* node = head->m_next;
+        head->m_prev->m_next = nullptr;
+        head->m_prev = head->m_next = head;
+        while (node && node != head) {
+            ExpireNode* next = node->m_next;
+            link(node);
+            node = next;
+        }
+        if (index != 0) break;
+        shift += LEVEL_BITS;
+    }
+}
+
+void CacheTimerWheel::schedule(CacheEntry* entry, int64 expireTime) {
+    ExpireNode* node = entry->getExpireNode();
+    if (node) {
+        unlink(node);
+    }
+    else {
+        node = new ExpireNode();
+        node->m_entry = entry;
+        entry->setExpireNode(node);
+        m_size++;
+    }
+    node->m_expireTime = expireTime;
+    link(node);
+}
+
+void CacheTimerWheel::remove(CacheEntry* entry) {
+    ExpireNode* node = entry->getExpireNode();
+    if (!node) return;
+    unlink(node);
+    delete node;
+    entry->setExpireNode(nullptr);
+    m_size--;
+}
+
+int64 CacheTimerWheel::advance(int64 now, Clock::time_point deadline,
+    const std::function<void(CacheEntry*)>& func) {
+    // 时间轮为空时直接跳到当前时间
+    if (m_size <= 0) {
+        if (m_current <= now) m_current = now + 1;
+        return 0;
+    }
+    int64 count = 0;
+    while (m_current <= now) {
+        int64 index = m_current & (ROOT_SIZE - 1);
+        if (index == 0 && m_cascaded != m_current) {
+            cascade();
+            m_cascaded = m_current;
+        }
+        ExpireNode* head = &m_root[index];
+        while (head->m_next != head) {
+            if ((count & CLOCK_CHECK_MASK) == CLOCK_CHECK_MASK &&
+                Clock::now() >= deadline) {
+                return count;
+            }
+            ExpireNode* node = head->m_next;
+            unlink(node);
+            if (node->m_expireTime > m_current) {
+                link(node);
+                continue;
+            }
+            CacheEntry* entry = node->m_entry;
+            entry->setExpireNode(nullptr);
+            delete node;
+            m_size--;
+            func(entry);
+            count++;
+        }
+        m_current++;
+    }
+    return count;
+}
+
+int64 CacheTimerWheel::getMemory() const {
+    return sizeof(*this) + m_size * (int64)sizeof(ExpireNode);
+}
+
+int64 IdleWheel::now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+IdleWheel::IdleWheel(int64 duration, int64 now) : m_now(now) {
+    m_tickSize = std::max(MIN_IDLE_TICK,
+        (duration + IDLE_WHEEL_TICKS - 1) / IDLE_WHEEL_TICKS);
+    m_current = now / m_tickSize;
+    // 最晚的检查时间为最后访问时间加上sessionDuration和一个槽位
+    m_slots.resize((size_t)(duration / m_tickSize + 3));
+    for (auto& head : m_slots) {
+        head.m_prev = head.m_next = &head;
+    }
+}
+
+IdleWheel::~IdleWheel() {
+    for (auto& head : m_slots) {
+        while (head.m_next != &head) {
+            remove(head.m_next);
+        }
+    }
+}
+
+void IdleWheel::schedule(IdleNode* node, int64 time) {
+    remove(node);
+    int64 count = (int64)m_slots.size();
+    int64 tick = (time + m_tickSize - 1) / m_tickSize;
+    // 已经到期的节点在下一次推进时处理；超出一圈的节点提前检查，检查
+    // 时未超时会重新放入
+    tick = std::min(std::max(tick, m_current), m_current + count - 1);
+    IdleNode* head = &m_slots[(size_t)(tick % count)];
+    node->m_prev = head->m_prev;
+    node->m_next = head;
+    head->m_prev->m_next = node;
+    head->m_prev = node;
+}
+
+void IdleWheel::remove(IdleNode* node) {
+    if (!node->m_prev) return;
+    node->m_prev->m_next = node->m_next;
+    node->m_next->m_prev = node->m_prev;
+    node->m_prev = node->m_next = nullptr;
+}
+
+int64 IdleWheel::advance(int64 now,
+    const std::function<void(IdleNode*)>& func) {
+    m_now = now;
+    int64 count = 0;
+    int64 target = now / m_tickSize;
+    while (m_current <= target) {
+        IdleNode* head = &m_slots[(size_t)(m_current % m_slots.size())];
+        m_current++;
+        if (head->m_next == head) continue;
+        // 先把整个链表移到临时的头节点上，重新放入的节点不会回到正在
+        // 处理的链表中；func关闭连接时移除其他节点也不受影响
+        IdleNode due;
+        due.m_next = head->m_next;
+        due.m_prev = head->m_prev;
+        due.m_next->m_prev = &due;
+        due.m_prev->m_next = &due;
+        head->m_prev = head->m_next = head;
+        while (due.m_next != &due) {
+            IdleNode* node = due.m_next;
+            remove(node);
+            func(node);
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "cache-base.h"
+#include "cache-entry.h"
+#include <chrono>
+#include <functional>
+#include <vector>
+
+// 分层时间轮：每个tick为1ms。第0层256个槽位，第1至4层各64个槽位，每个
+// 槽位的跨度等于下一层的总跨度，一共覆盖2^32ms(约49天)，更远的过期时间
+// 先放在最高层，转移时重新计算位置。每个槽位是一个带头节点的循环双向
+// 链表，ExpireNode的插入和删除都是O(1)；第0层槽位的下标回到0时，上一层
+// 当前槽位中的节点转移到下层。只有设置了过期时间的key在时间轮中，
+// 处理到期节点的代价只和到期的key数量相关。
+class CacheTimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    static const int LEVELS = 5;
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const int64 MAX_DELAY = (1LL << 32) - 1;
+
+    ExpireNode m_root[ROOT_SIZE];
+    ExpireNode m_levels[LEVELS - 1][LEVEL_SIZE];
+    // 下一个需要处理的tick(ms)
+    int64 m_current;
+    // 已经完成转移的tick，处理中途超时后继续处理时不再重复转移
+    int64 m_cascaded = -1;
+    int64 m_size = 0;
+
+    // 根据过期时间和m_current把节点放入对应槽位
+    void link(ExpireNode* node);
+    static void unlink(ExpireNode* node);
+    static void clear(ExpireNode* head);
+    void cascade();
+
+public:
+    CacheTimerWheel(int64 now);
+    ~CacheTimerWheel();
+
+    // 设置或者修改key的过期时间(ms时间戳)
+    void schedule(CacheEntry* entry, int64 expireTime);
+    // 删除key的过期时间，未设置时不做任何操作
+    void remove(CacheEntry* entry);
+
+    // 处理now之前到期的节点：节点从时间轮移除之后调用func(entry)。
+    // 超过deadline时停止，剩余的节点留到下一次处理。返回处理的节点数量
+    int64 advance(int64 now, Clock::time_point deadline,
+        const std::function<void(CacheEntry*)>& func);
+
+    // 设置了过期时间的key数量
+    int64 getSize() const { return m_size; }
+    int64 getMemory() const;
+};
+
+class Session;
+
+// 空闲连接时间轮中的节点，嵌入Session
+struct IdleNode {
+    IdleNode* m_prev = nullptr;
+    IdleNode* m_next = nullptr;
+    Session* m_session = nullptr;
+};
+
+// 空闲连接时间轮：每个I/O线程一个，代替每个Session一个deadline_timer。
+// 单层，每个槽位跨度为sessionDuration的1/256(至少10ms)，槽位数量覆盖
+// 一个sessionDuration，不需要分层。读取数据只更新Session的最后访问时间，
+// 不移动节点；槽位到期时才检查其中的连接，未超时的按照最后访问时间重新
+// 放入。时钟在每次推进时更新，最后访问时间使用缓存的时钟。时间使用
+// 单调时钟，系统时间被调整时连接不会提前或者推迟超时。
+class IdleWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    // 每个槽位的跨度(ms)
+    int64 m_tickSize;
+    // 下一个需要处理的tick
+    int64 m_current;
+    // 缓存的时钟(ms)，最多落后一个槽位
+    int64 m_now;
+    std::vector<IdleNode> m_slots;
+
+public:
+    IdleWheel(int64 duration, int64 now);
+    // 剩余的节点只从链表中断开，Session在之后销毁时不再访问槽位
+    ~IdleWheel();
+
+    // 在time(ms)之后检查节点，已经在时间轮中的节点重新放置
+    void schedule(IdleNode* node, int64 time);
+    // 不在时间轮中时不做任何操作
+    static void remove(IdleNode* node);
+
+    // 更新时钟为now，到期槽位中的节点从时间轮移除之后调用func(node)，
+    // func可以重新放入节点。返回处理的节点数量
+    int64 advance(int64 now, const std::function<void(IdleNode*)>& func);
+
+    int64 getTickSize() const { return m_tickSize; }
+    int64 getNow() const { return m_now; }
+
+    // 单调时钟的当前时间(ms)，用于构造和推进时间轮
+    static int64 now();
+};
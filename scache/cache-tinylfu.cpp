@@ -0,0 +1,220 @@
+#include "cache-tinylfu.h"
+#include "cache-dict.h"
+#include <algorithm>
+
+// 4个计数器各自使用不同的种子计算位置
+const uint64_t SKETCH_SEEDS[] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+    0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL };
+
+// 计数器最大值
+const uint64_t SKETCH_MAX_COUNT = 15;
+
+// 候选频率不高于淘汰对象时仍有1/128概率准入的频率下限，避免攻击者
+// 提高淘汰对象频率后使所有新key都无法进入缓存
+const int ADMIT_RANDOM_THRESHOLD = 6;
+
+const int64 WINDOW_PERCENT = 1;
+const int64 PROTECTED_PERCENT = 80;
+
+static uint64_t roundUpPower(int64 size) {
+    uint64_t result = 1;
+    while ((int64)result < size) result <<= 1;
+    return result;
+}
+
+CacheSketch::CacheSketch(int64 maximum) {
+    maximum = std::max<int64>(maximum, 64);
+    uint64_t size = roundUpPower(maximum);
+    m_table.assign(size, 0);
+    m_tableMask = size - 1;
+    // doorkeeper每个key平均8位
+    m_doorkeeper.assign(size / 8, 0);
+    m_doorkeeperMask = size * 8 - 1;
+    m_sampleSize = maximum * 10;
+}
+
+uint64_t CacheSketch::indexOf(uint64_t hash, int i) const {
+    uint64_t h = (hash + SKETCH_SEEDS[i]) * SKETCH_SEEDS[i];
+    h += h >> 32;
+    return h & m_tableMask;
+}
+
+bool CacheSketch::inDoorkeeper(uint64_t hash) const {
+    uint64_t h1 = hash & m_doorkeeperMask;
+    uint64_t h2 = (hash >> 32) * SKETCH_SEEDS[0] >> 32 & m_doorkeeperMask;
+    return (m_doorkeeper[h1 >> 6] >> (h1 & 63) & 1) &&
+        (m_doorkeeper[h2 >> 6] >> (h2 & 63) & 1);
+}
+
+bool CacheSketch::putDoorkeeper(uint64_t hash) {
+    if (inDoorkeeper(hash)) return true;
+    uint64_t h1 = hash & m_doorkeeperMask;
+    uint64_t h2 = (hash >> 32) * SKETCH_SEEDS[0] >> 32 & m_doorkeeperMask;
+    m_doorkeeper[h1 >> 6] |= 1ULL << (h1 & 63);
+    m_doorkeeper[h2 >> 6] |= 1ULL << (h2 & 63);
+    return false;
+}
+
+void CacheSketch::increment(uint64_t hash) {
+    if (putDoorkeeper(hash)) {
+        // 每个key在一个uint64_t中使用的4个计数器由哈希值低2位决定
+        int start = (int)(hash & 3) << 2;
+        for (int i = 0; i < 4; i++) {
+            uint64_t& word = m_table[indexOf(hash, i)];
+            int offset = (start + i) << 2;
+            if ((word >> offset & SKETCH_MAX_COUNT) < SKETCH_MAX_COUNT)
+                word += 1ULL << offset;
+        }
+    }
+    if (++m_size >= m_sampleSize) reset();
+}
+
+int CacheSketch::frequency(uint64_t hash) const {
+    int start = (int)(hash & 3) << 2;
+    uint64_t result = SKETCH_MAX_COUNT;
+    for (int i = 0; i < 4; i++) {
+        uint64_t word = m_table[indexOf(hash, i)];
+        int offset = (start + i) << 2;
+        result = std::min(result, word >> offset & SKETCH_MAX_COUNT);
+    }
+    return (int)result + (inDoorkeeper(hash) ? 1 : 0);
+}
+
+// 所有计数器减半，清空doorkeeper
+void CacheSketch::reset() {
+    for (auto& word : m_table) {
+        word = (word >> 1) & 0x7777777777777777ULL;
+    }
+    std::fill(m_doorkeeper.begin(), m_doorkeeper.end(), 0);
+    m_size /= 2;
+}
+
+int64 CacheSketch::getMemory() const {
+    return (int64)(m_table.size() + m_doorkeeper.size()) * sizeof(uint64_t);
+}
+
+
+CacheTinyLfu::CacheTinyLfu(int64 maximum) : m_sketch(maximum) {
+    m_window = new LinkedList();
+    m_probation = new LinkedList();
+    m_protected = new LinkedList();
+    m_windowMax = std::max<int64>(1, maximum * WINDOW_PERCENT / 100);
+    m_protectedMax = (maximum - m_windowMax) * PROTECTED_PERCENT / 100;
+}
+
+// 节点由SimpleCache回收，链表只负责回收头节点
+CacheTinyLfu::~CacheTinyLfu() {
+    delete m_window;
+    delete m_probation;
+    delete m_protected;
+}
+
+CacheTinyLfu::LinkedList* CacheTinyLfu::getList(CacheEntry* entry) {
+    switch (entry->getSegment()) {
+    case ProbationSegment:
+        return m_probation;
+    case ProtectedSegment:
+        return m_protected;
+    default:
+        return m_window;
+    }
+}
+
+void CacheTinyLfu::moveTo(CacheEntry* entry, CacheSegment segment) {
+    getList(entry)->popNode(entry);
+    entry->setSegment(segment);
+    getList(entry)->addNode(entry);
+}
+
+// 链表为空时尾指针为nullptr或者头节点
+CacheEntry* CacheTinyLfu::getLast(LinkedList* list) {
+    if (list->getSize() <= 0) return nullptr;
+    return static_cast<CacheEntry*>(list->getTail());
+}
+
+uint64_t CacheTinyLfu::hashOf(CacheEntry* entry) {
+    return CacheHash<std::string_view>()(entry->getKey());
+}
+
+void CacheTinyLfu::add(CacheEntry* entry) {
+    m_sketch.increment(hashOf(entry));
+    entry->setSegment(WindowSegment);
+    m_window->addNode(entry);
+}
+
+void CacheTinyLfu::touch(CacheEntry* entry) {
+    m_sketch.increment(hashOf(entry));
+    switch (entry->getSegment()) {
+    case ProbationSegment:
+        moveTo(entry, ProtectedSegment);
+        // protected溢出时最久未访问的节点降级到probation首部
+        if (m_protected->getSize() > m_protectedMax) {
+            moveTo(getLast(m_protected), ProbationSegment);
+        }
+        break;
+    default:
+        moveTo(entry, entry->getSegment());
+        break;
+    }
+}
+
+void CacheTinyLfu::remove(CacheEntry* entry) {
+    getList(entry)->popNode(entry);
+}
+
+bool CacheTinyLfu::admit(CacheEntry* candidate, CacheEntry* victim,
+    uint64_t random) {
+    int candidateFreq = m_sketch.frequency(hashOf(candidate));
+    int victimFreq = m_sketch.frequency(hashOf(victim));
+    if (candidateFreq > victimFreq) return true;
+    if (candidateFreq >= ADMIT_RANDOM_THRESHOLD) return (random & 127) == 0;
+    return false;
+}
+
+CacheEntry* CacheTinyLfu::getVictim(uint64_t random) {
+    while (m_window->getSize() > m_windowMax) {
+        auto candidate = getLast(m_window);
+        auto victim = getLast(m_probation);
+        if (!victim) victim = getLast(m_protected);
+        // 主区域为空，候选直接进入主区域
+        if (!victim) {
+            moveTo(candidate, ProbationSegment);
+            continue;
+        }
+        if (admit(candidate, victim, random)) {
+            moveTo(candidate, ProbationSegment);
+            return victim;
+        }
+        return candidate;
+    }
+    if (auto victim = getLast(m_probation)) return victim;
+    if (auto victim = getLast(m_protected)) return victim;
+    return getLast(m_window);
+}
+
+void CacheTinyLfu::shrinkWindow() {
+    while (m_window->getSize() > m_windowMax) {
+        moveTo(getLast(m_window), ProbationSegment);
+    }
+}
+
+std::vector<CacheTinyLfu::LinkedList*> CacheTinyLfu::getLists() {
+    return { m_window, m_probation, m_protected };
+}
+
+int64 CacheTinyLfu::getMemory() const {
+    return m_sketch.getMemory();
+}
+
+std::string CacheTinyLfu::getInfo() {
+    std::string result;
+    result += "tinylfu_window:" + std::to_string(m_window->getSize()) +
+        "\r\n";
+    result += "tinylfu_probation:" +
+        std::to_string(m_probation->getSize()) + "\r\n";
+    result += "tinylfu_protected:" +
+        std::to_string(m_protected->getSize()) + "\r\n";
+    result += "sketch_memory:" + std::to_string(getMemory()) + "\r\n";
+    return result;
+}
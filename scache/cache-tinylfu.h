@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cache-base.h"
+#include "cache-entry.h"
+#include "cache-list.h"
+#include <cstdint>
+#include <vector>
+
+// 访问频率估计：4位计数器的count-min sketch，每个uint64_t保存16个计数器，
+// 每个key对应4个计数器，取最小值。doorkeeper布隆过滤器吸收只出现一次
+// 的key，第二次出现才进入sketch。累计记录次数达到10倍容量时所有计数器
+// 减半并清空doorkeeper，使频率随时间衰减。
+class CacheSketch {
+private:
+    std::vector<uint64_t> m_table;
+    std::vector<uint64_t> m_doorkeeper;
+    uint64_t m_tableMask = 0;
+    uint64_t m_doorkeeperMask = 0;
+    int64 m_sampleSize = 0;
+    int64 m_size = 0;
+
+    uint64_t indexOf(uint64_t hash, int i) const;
+    bool inDoorkeeper(uint64_t hash) const;
+    // 返回key之前是否已经在doorkeeper中
+    bool putDoorkeeper(uint64_t hash);
+    void reset();
+
+public:
+    CacheSketch(int64 maximum);
+
+    void increment(uint64_t hash);
+    int frequency(uint64_t hash) const;
+    int64 getMemory() const;
+};
+
+// W-TinyLFU：新节点进入窗口LRU(容量的1%)，窗口溢出的节点作为候选与主
+// 区域的淘汰对象比较访问频率，频率更高者留下。主区域为SLRU：probation
+// 中的节点再次被访问时晋升到protected(主区域的80%)，protected溢出的节点
+// 降级回probation。节点所在区域记录在CacheEntry中。
+class CacheTinyLfu {
+public:
+    using LinkedList = CacheList<CacheValue>;
+
+private:
+    CacheSketch m_sketch;
+    LinkedList* m_window;
+    LinkedList* m_probation;
+    LinkedList* m_protected;
+    int64 m_windowMax;
+    int64 m_protectedMax;
+
+    LinkedList* getList(CacheEntry* entry);
+    void moveTo(CacheEntry* entry, CacheSegment segment);
+    static CacheEntry* getLast(LinkedList* list);
+    static uint64_t hashOf(CacheEntry* entry);
+    // 候选和淘汰对象比较访问频率，决定候选是否进入主区域
+    bool admit(CacheEntry* candidate, CacheEntry* victim, uint64_t random);
+
+public:
+    CacheTinyLfu(int64 maximum);
+    ~CacheTinyLfu();
+
+    void add(CacheEntry* entry);
+    void touch(CacheEntry* entry);
+    void remove(CacheEntry* entry);
+
+    // 选择被淘汰的节点，窗口溢出时先进行准入比较，没有节点时返回nullptr
+    CacheEntry* getVictim(uint64_t random);
+    // 缓存未满时窗口溢出的节点直接进入主区域
+    void shrinkWindow();
+
+    std::vector<LinkedList*> getLists();
+    int64 getMemory() const;
+    std::string getInfo();
+};
@@ -1,15 +1,24 @@
 #include "cache-tool.h"
-#include <sstream>
+#include <charconv>
 #include <string>
 #include <chrono>
 
-bool isNumber(std::string str) {
-    std::stringstream sin(str);
-    long long n;
-    char p;
-    if (!(sin >> n)) return false;
-    if (sin >> p)    return false; 
-    else             return true; 
+bool isNumber(std::string_view str) {
+    int64 number = 0;
+    return toNumber(str, number);
+}
+
+// token不以'\0'结尾，使用from_chars转换
+bool toNumber(std::string_view str, int64& number) {
+    if (str.empty() || str.size() > 20) return false;
+    const char* begin = str.data();
+    const char* end = begin + str.size();
+    if (*begin == '+') {
+        begin++;
+        if (begin == end || *begin == '-') return false;
+    }
+    auto result = std::from_chars(begin, end, number);
+    return result.ec == std::errc() && result.ptr == end;
 }
 
 int64 getCurrentTime() {
@@ -1,5 +1,6 @@
 #pragma once
 #include<string>
+#include<string_view>
 
 #define getHeadPointer(address, type, field) \
     ((type *)((char *)(address)-(unsigned long)(&((type *)0)->field)))
@@ -7,6 +8,8 @@
 
 using int64 = long long;
 
-bool isNumber(std::string);
+bool isNumber(std::string_view);
 
-int64 getCurrentTime();
\ No newline at end of file
+int64 getCurrentTime();
+// 字符串可以完整转换为整型数时返回true，结果存储在number中
+bool toNumber(std::string_view str, int64& number);
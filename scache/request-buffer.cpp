@@ -1,39 +1,216 @@
 #include "request-buffer.h"
-#include <condition_variable>
+#include <algorithm>
+#include <climits>
+#include <thread>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REQUEST_USE_PAUSE
+#endif
+
+// 消费者阻塞之前自旋检查的次数
+const int64 REQUEST_SPIN_COUNT = 2000;
+
+static inline void cpuRelax() {
+#ifdef REQUEST_USE_PAUSE
+    _mm_pause();
+#endif
+}
+
+uint32_t RequestEvent::prepareWait() {
+    m_waiters.fetch_add(1);
+    // 与notify中的屏障配对：要么等待方看到修改之后的条件，要么唤醒方
+    // 看到等待方
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_value.load(std::memory_order_acquire);
+}
+
+void RequestEvent::cancelWait() {
+    m_waiters.fetch_sub(1);
+}
+
+void RequestEvent::wait(uint32_t key) {
+#ifdef __linux__
+    while (m_value.load(std::memory_order_acquire) == key) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_value),
+            FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+    }
+#else
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cond.wait(lock, [this, key]() {
+        return m_value.load(std::memory_order_acquire) != key; });
+#endif
+    m_waiters.fetch_sub(1);
+}
+
+void RequestEvent::notify(bool all) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiters.load(std::memory_order_relaxed) == 0) return;
+#ifdef __linux__
+    m_value.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_value),
+        FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#else
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_value.fetch_add(1, std::memory_order_release);
+    }
+    if (all) m_cond.notify_all();
+    else m_cond.notify_one();
+#endif
+}
 
 
 RequestBuffer::RequestBuffer() {
     m_globalConfig = getGlobalConfig();
+    uint64_t capacity = 2;
+    while ((int64)capacity < m_globalConfig->requestBufferSize) {
+        capacity <<= 1;
+    }
+    m_slots = new Slot[capacity];
+    for (uint64_t i = 0; i < capacity; i++) {
+        m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+    m_mask = capacity - 1;
+    m_spinCount = std::thread::hardware_concurrency() > 1 ?
+        REQUEST_SPIN_COUNT : 0;
 }
 
-void RequestBuffer::addRequest(Request &rq) {
-    std::unique_lock<std::mutex> lock(m_lock);
-    int64 maxSize = m_globalConfig->requestBufferSize;
-    if (m_buffer.size() >= maxSize) {
-        m_addCond.wait(lock, [this, maxSize]() 
-        { return m_buffer.size() < maxSize / 2; });
+RequestBuffer::~RequestBuffer() {
+    delete[] m_slots;
+}
+
+bool RequestBuffer::tryPush(Request& rq, bool bulk) {
+    if (bulk && getSize() >= getCapacity() - getCapacity() / 4) {
+        m_fullCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = m_slots[tail & m_mask];
+        uint64_t sequence = slot.m_sequence.load(std::memory_order_acquire);
+        int64 diff = (int64)(sequence - tail);
+        if (diff == 0) {
+            if (m_tail.compare_exchange_weak(tail, tail + 1,
+                std::memory_order_relaxed)) {
+                slot.m_request = std::move(rq);
+                slot.m_sequence.store(tail + 1, std::memory_order_release);
+                m_readable.notify(false);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            // 槽位中的请求还没有被取出，队列已满
+            m_fullCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            tail = m_tail.load(std::memory_order_relaxed);
+        }
     }
-    m_buffer.push(std::move(rq));
-    m_getCond.notify_one();
 }
 
-Request RequestBuffer::getRequest() {
-    std::unique_lock<std::mutex> lock(m_lock);
-    if (m_buffer.size() <= 0) {
-        m_getCond.wait(lock);
+void RequestBuffer::addRequest(Request& rq) {
+    while (!tryPush(rq)) {
+        uint32_t key = m_writable.prepareWait();
+        // 等待期间消费者可能已经取出请求
+        Slot& slot = m_slots[m_tail.load(std::memory_order_relaxed) & m_mask];
+        if ((int64)(slot.m_sequence.load(std::memory_order_acquire) -
+            m_tail.load(std::memory_order_relaxed)) >= 0) {
+            m_writable.cancelWait();
+            continue;
+        }
+        m_writable.wait(key);
+    }
+}
+
+bool RequestBuffer::tryPop(Request& rq) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[head & m_mask];
+    if (slot.m_sequence.load(std::memory_order_acquire) != head + 1) {
+        return false;
+    }
+    rq = std::move(slot.m_request);
+    // 槽位在下一轮可写
+    slot.m_sequence.store(head + m_mask + 1, std::memory_order_release);
+    m_head.store(head + 1, std::memory_order_relaxed);
+    return true;
+}
+
+int64 RequestBuffer::getSize() const {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    // 两次读取之间消费者可能已经越过读到的m_tail
+    return tail > head ? (int64)(tail - head) : 0;
+}
+
+void RequestBuffer::waitReadable() {
+    auto readable = [this]() {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        return m_slots[head & m_mask].m_sequence.load(
+            std::memory_order_acquire) == head + 1;
+    };
+    for (int64 i = 0; i < m_spinCount; i++) {
+        if (readable()) return;
+        cpuRelax();
+    }
+    while (!readable()) {
+        uint32_t key = m_readable.prepareWait();
+        if (readable()) {
+            m_readable.cancelWait();
+            return;
+        }
+        m_readable.wait(key);
     }
-    auto request = m_buffer.front();
-    m_buffer.pop();
-    m_addCond.notify_one();
+}
+
+int64 RequestBuffer::getRequests(std::vector<Request>& requests,
+    int64 maxCount) {
+    requests.resize(std::max<int64>(maxCount, 1));
+    waitReadable();
+    int64 count = 0;
+    while (count < (int64)requests.size() && tryPop(requests[count])) {
+        count++;
+    }
+    // 唤醒所有因为队列已满而等待的生产者
+    m_writable.notify(true);
+    return count;
+}
+
+Request RequestBuffer::getRequest() {
+    Request request;
+    waitReadable();
+    tryPop(request);
+    m_writable.notify(true);
     return request;
 }
 
-RequestBuffer* getRequestBuffer() {
-    static RequestBuffer* buffer = new RequestBuffer();
-    return buffer;
+std::vector<RequestBuffer*>& getRequestBuffers() {
+    static std::vector<RequestBuffer*> buffers = []() {
+        std::vector<RequestBuffer*> result;
+        int64 count = std::max<int64>(1, getGlobalConfig()->shardCount);
+        for (int64 i = 0; i < count; i++) {
+            result.push_back(new RequestBuffer());
+        }
+        return result;
+    }();
+    return buffers;
+}
+
+RequestBuffer* getRequestBuffer(int64 shard) {
+    return getRequestBuffers()[shard];
 }
 
 void delRequestBuffer() {
-    delete getRequestBuffer();
-}
\ No newline at end of file
+    for (auto buffer : getRequestBuffers()) {
+        delete buffer;
+    }
+    getRequestBuffers().clear();
+}
@@ -1,36 +1,142 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "cache-base.h"
 #include "cache-config.h"
 
+// 连接的接收缓冲区，解析得到的Request持有其引用，请求处理完成之前缓冲区
+// 中的数据不会被覆盖
+using RequestData = std::shared_ptr<std::string>;
+
+// 连接使用的协议：文本指令或者RESP2，决定结果的编码方式
+enum RequestProtocol { TextProtocol, RespProtocol };
+
+// 连接句柄：低8位为连接所在的I/O线程，8~31位为连接在I/O线程中的槽位，
+// 高32位为槽位的代数。连接关闭之后槽位的代数加一，旧的句柄不再有效。
+// 代数从1开始，0不是任何连接的句柄
+using SessionHandle = uint64_t;
+const SessionHandle INVALID_SESSION = 0;
+
+// 跨分片的多key指令，定义在cache-server.h
+struct MultiRequest;
+
 struct Request {
-    std::string m_name;
-    std::vector<std::string> cmd;
+    // 发起请求的连接，结果由该连接所在的I/O线程发送
+    SessionHandle m_session = INVALID_SESSION;
+    // 指向m_data中的token
+    std::vector<std::string_view> cmd;
+    RequestData m_data;
+    // 指令在连接中的序号，结果按照序号顺序写回
+    uint64_t m_sequence = 0;
+    RequestProtocol m_protocol = TextProtocol;
+    // 跨分片的多key指令拆分得到的子请求共享同一个MultiRequest
+    std::shared_ptr<MultiRequest> m_multi;
+    // 读取较长字符串值的指令把值的引用放在这里，结果中不包含值本身
+    CacheStringRef m_value;
 };
 
-class RequestBuffer {
+// 执行线程交给连接写回的结果：m_data之后是m_value引用的值，值不拷贝，
+// 直接从缓存中存储的位置写回。RESP2协议中m_value是bulk string的内容，
+// 之后写回"\r\n"
+struct Reply {
+    std::string m_data;
+    CacheStringRef m_value;
+
+    Reply() = default;
+    Reply(std::string data, CacheStringRef value = CacheStringRef())
+        : m_data(std::move(data)), m_value(std::move(value)) {}
+    bool empty() const { return m_data.empty() && !m_value; }
+    // 文本协议的长度前缀
+    size_t size() const { return m_data.size() + m_value.size(); }
+};
+
+// 等待和唤醒：等待方先调用prepareWait取得当前值，再次检查条件仍不满足
+// 时调用wait；唤醒方修改条件之后调用notify，没有等待方时不需要系统调用。
+// Linux使用futex，其他平台使用互斥锁和条件变量
+class RequestEvent {
 private:
-    std::queue<Request> m_buffer;
+    std::atomic<uint32_t> m_value{ 0 };
+    std::atomic<int32_t> m_waiters{ 0 };
+#ifndef __linux__
     std::mutex m_lock;
-    std::condition_variable m_addCond;
-    std::condition_variable m_getCond;
+    std::condition_variable m_cond;
+#endif
+
+public:
+    uint32_t prepareWait();
+    void cancelWait();
+    // m_value不等于key时立即返回
+    void wait(uint32_t key);
+    void notify(bool all);
+};
+
+// 有界无锁MPSC环形队列：多个线程添加请求，只有分片的执行线程取出请求。
+// 每个槽位独占一个缓存行，保存一个序号：序号等于写入位置时可写，等于
+// 写入位置+1时可读。生产者使用CAS竞争写入位置，消费者独占读取位置，
+// 请求在槽位中移动，不拷贝。容量为requestBufferSize向上取整到2的幂。
+class RequestBuffer {
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> m_sequence;
+        Request m_request;
+    };
+
+    Slot* m_slots;
+    uint64_t m_mask;
+
+    // 生产者和消费者使用的位置分别独占一个缓存行。只有消费者修改
+    // m_head，其他线程只在统计队列长度时读取
+    alignas(64) std::atomic<uint64_t> m_tail{ 0 };
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };
+    // tryPush因为队列已满(或者bulk请求超过上限)失败的次数
+    std::atomic<int64> m_fullCount{ 0 };
+
+    // 队列为空时消费者等待m_readable，队列已满时生产者等待m_writable
+    alignas(64) RequestEvent m_readable;
+    RequestEvent m_writable;
+
+    // 单核机器上自旋只会推迟生产者的执行
+    int64 m_spinCount;
 
     GlobalConfig* m_globalConfig;
 
     RequestBuffer();
-    virtual ~RequestBuffer() = default;
+    virtual ~RequestBuffer();
+
+    bool tryPop(Request& rq);
+    // 消费者自旋等待一段时间，仍然没有请求时阻塞
+    void waitReadable();
 
 public:
-    void addRequest(Request &rq);
+    // 队列已满时返回false，请求不会被移动。bulk为true时队列中的请求
+    // 达到容量的3/4就返回false，剩余的空间留给流水线较浅的连接
+    bool tryPush(Request& rq, bool bulk = false);
+    // 队列已满时等待消费者取出请求
+    void addRequest(Request& rq);
+
+    // 至少取出一个请求，最多取出maxCount个，没有请求时等待
+    int64 getRequests(std::vector<Request>& requests, int64 maxCount);
     Request getRequest();
 
-    friend RequestBuffer* getRequestBuffer();
+    int64 getCapacity() const { return (int64)m_mask + 1; }
+    // 队列中的请求数量，其他线程调用时为近似值
+    int64 getSize() const;
+    int64 getFullCount() const {
+        return m_fullCount.load(std::memory_order_relaxed);
+    }
+
+    friend std::vector<RequestBuffer*>& getRequestBuffers();
     friend void delRequestBuffer();
 };
 
-RequestBuffer* getRequestBuffer();
-void delRequestBuffer();
\ No newline at end of file
+// 每个分片一个RequestBuffer，第一次调用时按照shardCount创建
+std::vector<RequestBuffer*>& getRequestBuffers();
+RequestBuffer* getRequestBuffer(int64 shard = 0);
+void delRequestBuffer();
@@ -0,0 +1,109 @@
+#include "request-parser.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REQUEST_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// token结束的位置：第一个空白或者'\n'('\t'到'\r'以及' ')，没有时返回
+// size。较长的值一次检查16个字节
+static size_t findTokenEnd(const char* data, size_t i, size_t size) {
+#ifdef REQUEST_USE_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i low = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+    for (; i + 16 <= size; i += 16) {
+        auto bytes = _mm_loadu_si128((const __m128i*)(data + i));
+        // 无符号比较：bytes - '\t' <= '\r' - '\t'
+        auto offset = _mm_sub_epi8(bytes, low);
+        auto control = _mm_cmpeq_epi8(_mm_min_epu8(offset, range), offset);
+        auto mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(control,
+            _mm_cmpeq_epi8(bytes, space)));
+        if (mask == 0) continue;
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return i + index;
+#else
+        return i + __builtin_ctz(mask);
+#endif
+    }
+#endif
+    while (i < size && !isSpace(data[i]) && data[i] != '\n') i++;
+    return i;
+}
+
+void RequestParser::addToken(size_t end) {
+    m_tokens.emplace_back(m_tokenStart, end - m_frameStart - m_tokenStart);
+}
+
+bool RequestParser::next(const char* data, size_t size,
+    std::vector<std::string_view>& cmd) {
+    size_t i = m_position;
+    while (i < size) {
+        if (m_state == QuotedState) {
+            // 引号中的数据直接查找结束的引号
+            auto quote = (const char*)std::memchr(data + i, '"', size - i);
+            if (!quote) {
+                i = size;
+                break;
+            }
+            i = quote - data;
+            addToken(i);
+            m_state = SpaceState;
+            i++;
+            continue;
+        }
+        if (m_state == TokenState) {
+            i = findTokenEnd(data, i, size);
+            if (i == size) break;
+            addToken(i);
+            m_state = SpaceState;
+            continue;
+        }
+        char c = data[i];
+        if (c == '\n') {
+            if (m_tokens.empty()) {
+                // 空行
+                m_frameStart = i + 1;
+                i++;
+                continue;
+            }
+            const char* frame = data + m_frameStart;
+            cmd.clear();
+            for (auto& token : m_tokens) {
+                cmd.emplace_back(frame + token.first, token.second);
+            }
+            m_tokens.clear();
+            m_frameStart = m_position = i + 1;
+            return true;
+        }
+        if (c == '"') {
+            m_state = QuotedState;
+            m_tokenStart = i + 1 - m_frameStart;
+        }
+        else if (!isSpace(c)) {
+            m_state = TokenState;
+            m_tokenStart = i - m_frameStart;
+        }
+        i++;
+    }
+    m_position = i;
+    return false;
+}
+
+void RequestParser::moveFrame(size_t offset) {
+    m_position = m_position - m_frameStart + offset;
+    m_frameStart = offset;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 流式请求解析：每条指令以'\n'结尾('\r'和其他空白一样被忽略)，token之间
+// 使用空白分隔，双引号包围的token可以包含空白和换行，引号不属于token，
+// 不支持引号的嵌套。数据可以分多次到达，解析状态保存在RequestParser中，
+// 不完整的指令在收到更多数据时从上一次停止的位置继续扫描。token只记录
+// 相对于指令起始位置的偏移，缓冲区中的数据可以整体移动；解析结果是指向
+// 缓冲区的string_view，不需要为每个token分配内存。
+class RequestParser {
+private:
+    enum State { SpaceState, TokenState, QuotedState };
+
+    State m_state = SpaceState;
+    // 当前指令的起始位置，以及下一个需要扫描的位置
+    size_t m_frameStart = 0;
+    size_t m_position = 0;
+    // 正在扫描的token相对于指令起始位置的偏移
+    size_t m_tokenStart = 0;
+    // 已经完成的token相对于指令起始位置的偏移和长度
+    std::vector<std::pair<size_t, size_t>> m_tokens;
+
+    void addToken(size_t end);
+
+public:
+    // 从上一次停止的位置继续扫描data[0, size)。得到一条完整的指令时返回
+    // true，cmd指向data中的token；数据不完整时返回false。空行被忽略
+    bool next(const char* data, size_t size,
+        std::vector<std::string_view>& cmd);
+
+    // 不完整的指令的起始位置，之前的数据已经不再需要
+    size_t getFrameStart() const { return m_frameStart; }
+    // 不完整的指令被移动到缓冲区的offset位置
+    void moveFrame(size_t offset);
+};
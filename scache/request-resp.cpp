@@ -0,0 +1,168 @@
+#include "request-resp.h"
+#include <charconv>
+#include <cstring>
+
+// 数组长度和bulk string长度的默认上限，超过时作为格式错误
+const long long RESP_MAX_COUNT = 1 << 20;
+const long long RESP_MAX_BULK = 1 << 26;
+
+RespParser::RespParser() : m_maxBulk(RESP_MAX_BULK) {}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool RespParser::readNumber(const char* data, size_t size, char prefix,
+    long long& number) {
+    auto newline = (const char*)std::memchr(data + m_position, '\n',
+        size - m_position);
+    if (!newline) return false;
+    const char* begin = data + m_position;
+    const char* end = newline;
+    if (end > begin && end[-1] == '\r') end--;
+    if (end - begin < 2 || begin[0] != prefix) {
+        m_error = true;
+        return false;
+    }
+    auto parsed = std::from_chars(begin + 1, end, number);
+    if (parsed.ec != std::errc() || parsed.ptr != end) {
+        m_error = true;
+        return false;
+    }
+    m_position = newline + 1 - data;
+    return true;
+}
+
+void RespParser::finishFrame(const char* data,
+    std::vector<std::string_view>& cmd) {
+    const char* frame = data + m_frameStart;
+    cmd.clear();
+    for (auto& token : m_tokens) {
+        cmd.emplace_back(frame + token.first, token.second);
+    }
+    m_tokens.clear();
+    m_count = -1;
+    m_frameStart = m_position;
+}
+
+bool RespParser::nextInline(const char* data, size_t size,
+    std::vector<std::string_view>& cmd) {
+    auto newline = (const char*)std::memchr(data + m_position, '\n',
+        size - m_position);
+    if (!newline) {
+        m_position = size;
+        return false;
+    }
+    size_t end = newline - data;
+    size_t i = m_frameStart;
+    while (i < end) {
+        while (i < end && isSpace(data[i])) i++;
+        size_t start = i;
+        while (i < end && !isSpace(data[i])) i++;
+        if (i > start) {
+            m_tokens.emplace_back(start - m_frameStart, i - start);
+        }
+    }
+    m_position = end + 1;
+    if (m_tokens.empty()) {
+        // 空行
+        m_frameStart = m_position;
+        return false;
+    }
+    finishFrame(data, cmd);
+    return true;
+}
+
+bool RespParser::next(const char* data, size_t size,
+    std::vector<std::string_view>& cmd) {
+    while (!m_error && m_frameStart < size) {
+        if (m_count < 0) {
+            if (data[m_frameStart] != '*') {
+                if (nextInline(data, size, cmd)) return true;
+                if (m_position == size) return false;
+                continue;
+            }
+            if (!readNumber(data, size, '*', m_count)) return false;
+            if (m_count > RESP_MAX_COUNT) {
+                m_error = true;
+                return false;
+            }
+            if (m_count <= 0) {
+                // 空数组
+                m_count = -1;
+                m_frameStart = m_position;
+                continue;
+            }
+        }
+        while ((long long)m_tokens.size() < m_count) {
+            if (m_bulkLength < 0) {
+                if (m_position >= size ||
+                    !readNumber(data, size, '$', m_bulkLength)) {
+                    return false;
+                }
+                if (m_bulkLength < 0 || m_bulkLength > m_maxBulk) {
+                    m_error = true;
+                    return false;
+                }
+            }
+            // 数据和结尾的\r\n完整到达之前不需要扫描
+            size_t length = (size_t)m_bulkLength;
+            if (size - m_position < length + 2) return false;
+            if (data[m_position + length] != '\r' ||
+                data[m_position + length + 1] != '\n') {
+                m_error = true;
+                return false;
+            }
+            m_tokens.emplace_back(m_position - m_frameStart, length);
+            m_position += length + 2;
+            m_bulkLength = -1;
+        }
+        finishFrame(data, cmd);
+        return true;
+    }
+    return false;
+}
+
+size_t RespParser::getFrameHint() const {
+    if (m_bulkLength < 0) return 0;
+    return m_position - m_frameStart + (size_t)m_bulkLength + 2;
+}
+
+void RespParser::moveFrame(size_t offset) {
+    m_position = m_position - m_frameStart + offset;
+    m_frameStart = offset;
+}
+
+std::string respStatus(std::string_view status) {
+    std::string result = "+";
+    result += status;
+    result += "\r\n";
+    return result;
+}
+
+std::string respError(std::string_view message) {
+    std::string result = "-ERR ";
+    result += message;
+    result += "\r\n";
+    return result;
+}
+
+std::string respBulk(std::string_view value) {
+    std::string result;
+    appendRespBulk(result, value);
+    return result;
+}
+
+void appendRespArray(std::string& out, size_t count) {
+    out += '*';
+    out += std::to_string(count);
+    out += "\r\n";
+}
+
+void appendRespBulk(std::string& out, std::string_view value) {
+    out += '$';
+    out += std::to_string(value.size());
+    out += "\r\n";
+    out += value;
+    out += "\r\n";
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// RESP2协议：指令为bulk string数组"*<n>\r\n$<len>\r\n<data>\r\n..."，
+// bulk string按照长度前缀直接跳过，不扫描其中的数据，可以包含任意字节。
+// 不以'*'开头的一行作为inline指令(例如PING\r\n)，使用空白分隔，不支持
+// 引号。和RequestParser一样，token只记录相对于指令起始位置的偏移，解析
+// 结果是指向缓冲区的string_view。
+class RespParser {
+private:
+    // 当前指令的起始位置，以及下一个需要处理的位置
+    size_t m_frameStart = 0;
+    size_t m_position = 0;
+    // 数组长度，-1表示还没有读取数组头
+    long long m_count = -1;
+    // 当前bulk string的长度，-1表示还没有读取长度行
+    long long m_bulkLength = -1;
+    // bulk string长度的上限，超过时作为格式错误
+    long long m_maxBulk;
+    // 已经完成的token相对于指令起始位置的偏移和长度
+    std::vector<std::pair<size_t, size_t>> m_tokens;
+    bool m_error = false;
+
+    // 读取data[m_position]开始的一行中prefix之后的整数，一行不完整时
+    // 返回false，格式错误时设置m_error
+    bool readNumber(const char* data, size_t size, char prefix,
+        long long& number);
+    bool nextInline(const char* data, size_t size,
+        std::vector<std::string_view>& cmd);
+    void finishFrame(const char* data, std::vector<std::string_view>& cmd);
+
+public:
+    RespParser();
+    // 从上一次停止的位置继续处理data[0, size)。得到一条完整的指令时返回
+    // true；数据不完整或者格式错误时返回false，格式错误时isError为true
+    bool next(const char* data, size_t size,
+        std::vector<std::string_view>& cmd);
+    bool isError() const { return m_error; }
+
+    size_t getFrameStart() const { return m_frameStart; }
+    // 已经读取bulk string的长度行时，当前指令至少需要的长度(相对于指令
+    // 起始位置)，否则为0
+    size_t getFrameHint() const;
+    void setMaxBulk(size_t size) { m_maxBulk = (long long)size; }
+    void moveFrame(size_t offset);
+};
+
+// RESP2的返回值
+const std::string RESP_OK = "+OK\r\n";
+const std::string RESP_NIL = "$-1\r\n";
+
+std::string respStatus(std::string_view status);
+std::string respError(std::string_view message);
+std::string respBulk(std::string_view value);
+void appendRespArray(std::string& out, size_t count);
+void appendRespBulk(std::string& out, std::string_view value);